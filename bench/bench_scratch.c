@@ -0,0 +1,107 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+/* compares resetting a bitset with bitset_clear against the reset modes
+ | of bitset_scratch, for requests that set a few random bits each:
+ |
+ |   cc -std=c99 -O2 -I.. bench_scratch.c ../scratch.c ../bitset.c
+ |   ./a.out [bits] [sets per request] [requests]
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bitset.h"
+#include "scratch.h"
+
+static
+double bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* every run draws the same positions, so all see the same workload;
+ | the runs return the seconds taken, or a negative value if memory
+ | could not be allocated */
+static
+double bench_clear(size_t bits, size_t sets, size_t requests, size_t *sum)
+{
+	struct bitset_rng rng;
+	struct bitset *set = bitset_calloc(bits);
+	if (!set)
+		return -1;
+	bitset_rng_seed(&rng, 1);
+
+	double start = bench_now();
+	for (size_t r = 0; r < requests; ++r) {
+		for (size_t i = 0; i < sets; ++i)
+			bitset_set(set, bitset_rng_next(&rng) % bits, 1);
+		*sum += bitset_get(set, bitset_rng_next(&rng) % bits) != 0;
+		bitset_clear(set);
+	}
+	double time = bench_now() - start;
+	bitset_free(set);
+	return time;
+}
+
+static
+double bench_scratch(size_t bits, size_t sets, size_t requests,
+                     unsigned int mode, size_t *sum)
+{
+	struct bitset_rng rng;
+	struct bitset_scratch *scratch = bitset_scratch_new(bits, mode);
+	if (!scratch)
+		return -1;
+	bitset_rng_seed(&rng, 1);
+
+	double start = bench_now();
+	for (size_t r = 0; r < requests; ++r) {
+		for (size_t i = 0; i < sets; ++i)
+			bitset_scratch_set(scratch, bitset_rng_next(&rng) % bits, 1);
+		*sum += bitset_scratch_get(scratch, bitset_rng_next(&rng) % bits);
+		bitset_scratch_reset(scratch);
+	}
+	double time = bench_now() - start;
+	bitset_scratch_free(scratch);
+	return time;
+}
+
+int main(int argc, char **argv)
+{
+	size_t bits = argc > 1 ? strtoull(argv[1], NULL, 10) : 1 << 20;
+	size_t sets = argc > 2 ? strtoull(argv[2], NULL, 10) : 300;
+	size_t requests = argc > 3 ? strtoull(argv[3], NULL, 10) : 100000;
+	static const char *names[] = { "stamp", "sparse", "log" };
+	size_t sum = 0;
+
+	if (!bits || !requests) {
+		fprintf(stderr, "bits and requests must be positive\n");
+		return 1;
+	}
+
+	printf("%zu bits, %zu sets per request, %zu requests\n",
+	       bits, sets, requests);
+	for (int run = -1; run <= BITSET_SCRATCH_LOG; ++run) {
+		double time = run < 0 ? bench_clear(bits, sets, requests, &sum)
+		            : bench_scratch(bits, sets, requests, run, &sum);
+		if (time < 0) {
+			fprintf(stderr, "out of memory\n");
+			return 1;
+		}
+		printf("%-8s %8.3f us/request\n", run < 0 ? "clear" : names[run],
+		       time * 1e6 / requests);
+	}
+	/* keeps the lookups from being optimized away */
+	fprintf(stderr, "%zu\n", sum);
+	return 0;
+}
@@ -42,6 +42,9 @@ struct bitset *bitset_malloc(size_t num, unsigned int clear)
 		return NULL;
 	set->capacity = bitset_internal_capacity(bytes);
 	set->size = num;
+	set->count = 0;
+	set->ranks = NULL;
+	set->flags = 0;
 	return set;
 }
 
@@ -55,6 +58,9 @@ struct bitset *bitset_cpy(struct bitset *set)
 {
 	struct bitset *cpy = malloc(sizeof(struct bitset));
 	*cpy = *set;
+	/* the rank tree is owned by one set */
+	cpy->ranks = NULL;
+	cpy->flags &= ~BITSET_RANKED;
 	return cpy;
 }
 
@@ -64,10 +70,93 @@ struct bitset *bitset_cpy(struct bitset *set)
  */
 void bitset_free(struct bitset *set)
 {
+	free(set->ranks);
 	free(set->data);
 	free(set);
 }
 
+#define bitset_tree_blocks(size) \
+	(((size) + BITSET_RANKED_BLOCK - 1) / BITSET_RANKED_BLOCK)
+
+/* entries allocated for a tree of num blocks: a power of two, so that
+ | a tree that grows block by block is reallocated only log n times */
+static inline
+size_t bitset_tree_capacity(size_t num)
+{
+	size_t capacity = 1;
+	while (capacity < num + 1)
+		capacity <<= 1;
+	return capacity;
+}
+
+/* adds delta to the count of a block in the Fenwick tree */
+static inline
+void bitset_tree_add(struct bitset *set, size_t block, size_t delta)
+{
+	size_t num = bitset_tree_blocks(set->size);
+	for (size_t i = block + 1; i <= num; i += i & -i)
+		set->ranks[i] += delta;
+}
+
+/* returns the number of set bits in the blocks before block */
+static inline
+size_t bitset_tree_sum(struct bitset *set, size_t block)
+{
+	size_t sum = 0;
+	for (size_t i = block; i; i &= i - 1)
+		sum += set->ranks[i];
+	return sum;
+}
+
+/* adds (sign * the set bits of each block) inside begin to (end - 1) to
+ | the tree; returns 0 without doing anything if the range spans more
+ | than an eighth of the blocks, where rebuilding the tree is cheaper */
+static
+int bitset_tree_range(struct bitset *set, size_t begin, size_t end, int sign)
+{
+	if (begin >= end)
+		return 1;
+	size_t first = begin / BITSET_RANKED_BLOCK;
+	size_t last = (end - 1) / BITSET_RANKED_BLOCK;
+	if (last - first >= bitset_tree_blocks(set->size) / 8 + 1)
+		return 0;
+
+	for (size_t b = first; b <= last; ++b) {
+		size_t lo = b * BITSET_RANKED_BLOCK;
+		size_t hi = lo + BITSET_RANKED_BLOCK;
+		size_t count = bitset_rcount(set, lo > begin ? lo : begin,
+		                             hi < end ? hi : end);
+		bitset_tree_add(set, b, sign < 0 ? -count : count);
+	}
+	return 1;
+}
+
+/* recomputes the whole tree in linear time, resizing it to the size of
+ | the set; drops the tree and its flag if memory could not be allocated */
+static
+int bitset_tree_build(struct bitset *set)
+{
+	size_t num = bitset_tree_blocks(set->size);
+	size_t *ranks = realloc(set->ranks,
+	                        bitset_tree_capacity(num) * sizeof(size_t));
+	if (!ranks) {
+		free(set->ranks);
+		set->ranks = NULL;
+		set->flags &= ~BITSET_RANKED;
+		return 0;
+	}
+	set->ranks = ranks;
+
+	ranks[0] = 0;
+	for (size_t i = 1; i <= num; ++i)
+		ranks[i] = bitset_rcount(set, (i - 1) * BITSET_RANKED_BLOCK,
+		                         i * BITSET_RANKED_BLOCK);
+	for (size_t i = 1; i <= num; ++i)
+		if (i + (i & -i) <= num)
+			ranks[i + (i & -i)] += ranks[i];
+	return 1;
+}
+
 /* bitset_rclear(set, begin, end)
  |   clears the bits inside the given range (inclusive): begin to (end - 1);
  |   returns the number of bits cleared
@@ -77,13 +166,18 @@ void bitset_free(struct bitset *set)
  */
 size_t bitset_rclear(struct bitset *set, size_t begin, size_t end)
 {
+	if (set->flags & BITSET_COUNTED)
+		set->count -= bitset_rcount(set, begin, end);
+	int local = !(set->flags & BITSET_RANKED) ||
+	            bitset_tree_range(set, begin, end, -1);
+
 	unsigned int begin_shift = begin & 0x7;
 	unsigned int end_shift = end & 0x7;
 	unsigned char *begin_ptr = bitset_byte_at(set, begin);
 	unsigned char *end_ptr = bitset_byte_at(set, end);
 
 	if (begin_ptr == end_ptr)
-		*begin_ptr &= ~(~(~0 << (end - begin)) << begin);
+		*begin_ptr &= ~(~(~0 << (end - begin)) << begin_shift);
 	else {
 		unsigned char *first = begin_ptr + !!begin_shift;
 		size_t size = end_ptr - first;
@@ -91,14 +185,59 @@ size_t bitset_rclear(struct bitset *set, size_t begin, size_t end)
 			memset(first, 0, size);
 		if (begin_shift)
 			*begin_ptr &= ~(~0 << begin_shift);
-		*end_ptr &= ~0 << end_shift;
+		if (end_shift)
+			*end_ptr &= ~0 << end_shift;
+	}
+
+	if (!local)
+		bitset_tree_build(set);
+	return end - begin;
+}
+
+/* bitset_rset(set, begin, end)
+ |   sets the bits inside the given range (inclusive): begin to (end - 1);
+ |   returns the number of bits set
+ | set:   valid pointer to a [struct bitset]
+ | begin: index of the first bit (inclusive)
+ | end:   index of the ending bit (exclusive)
+ */
+size_t bitset_rset(struct bitset *set, size_t begin, size_t end)
+{
+	if (begin >= end)
+		return 0;
+	if (set->flags & BITSET_COUNTED)
+		set->count += end - begin - bitset_rcount(set, begin, end);
+	int local = !(set->flags & BITSET_RANKED) ||
+	            bitset_tree_range(set, begin, end, -1);
+
+	unsigned int begin_shift = begin & 0x7;
+	unsigned int end_shift = end & 0x7;
+	unsigned char *begin_ptr = bitset_byte_at(set, begin);
+	unsigned char *end_ptr = bitset_byte_at(set, end);
+
+	if (begin_ptr == end_ptr)
+		*begin_ptr |= ~(~0U << (end - begin)) << begin_shift;
+	else {
+		unsigned char *first = begin_ptr + !!begin_shift;
+		size_t size = end_ptr - first;
+		if (size)
+			memset(first, 0xff, size);
+		if (begin_shift)
+			*begin_ptr |= ~0U << begin_shift;
+		if (end_shift)
+			*end_ptr |= ~(~0U << end_shift);
 	}
 
+	if (!local)
+		bitset_tree_build(set);
+	else if (set->flags & BITSET_RANKED)
+		bitset_tree_range(set, begin, end, 1);
 	return end - begin;
 }
 
 /* bitset_resize(set, size)
- |   resizes the bitset to the specified amount of bits;
+ |   resizes the bitset to the specified amount of bits; a cached count
+ |   includes whatever the new bits happen to hold;
  |   returns the change in size (positive: increase, negative: decrease)
  | set:  valid pointer to a [struct bitset]
  | size: new size
@@ -106,12 +245,18 @@ size_t bitset_rclear(struct bitset *set, size_t begin, size_t end)
 intmax_t bitset_resize(struct bitset *set, size_t size)
 {
 	intmax_t diff = set->size - size;
+	size_t old_size = set->size;
 	size_t bytes = bitset_internal_bytes(size);
+	if ((set->flags & BITSET_COUNTED) && size < old_size)
+		set->count -= bitset_rcount(set, size, old_size);
 	set->data = realloc(set->data, bytes);
 	if (!set->data)
 		return 0;
 	set->capacity = bitset_internal_capacity(bytes);
 	set->size = size;
+	if ((set->flags & BITSET_COUNTED) && size > old_size)
+		set->count += bitset_rcount(set, old_size, size);
+	bitset_prefix_resize(set, old_size);
 	return diff;
 }
 
@@ -125,12 +270,128 @@ intmax_t bitset_resize(struct bitset *set, size_t size)
 intmax_t bitset_cresize(struct bitset *set, size_t size)
 {
 	size_t old_size = set->size;
+	if (size <= old_size)
+		return bitset_resize(set, size);
+
+	/* the new bits are cleared anyway, keep them out of the count */
+	unsigned int flags = set->flags;
+	set->flags &= ~(BITSET_COUNTED | BITSET_RANKED);
 	intmax_t diff = bitset_resize(set, size);
-	if (size > old_size)
-		bitset_rclear(set, old_size, set->size);
+	bitset_rclear(set, old_size, set->size);
+	set->flags = flags;
+	bitset_prefix_resize(set, old_size);
 	return diff;
 }
 
+/* bitset_reserve(set, size)
+ |   makes sure the bitset can hold the specified amount of bits without
+ |   reallocating; the capacity at least doubles when it has to grow,
+ |   the size is not changed;
+ |   returns the new capacity, or 0 if memory could not be allocated
+ |   (the bitset is left unchanged)
+ | set:  valid pointer to a [struct bitset]
+ | size: number of bits the bitset should be able hold
+ */
+size_t bitset_reserve(struct bitset *set, size_t size)
+{
+	size_t bytes = bitset_internal_bytes(size);
+	size_t have = bitset_bytes(set);
+	if (!size || bytes <= have)
+		return set->capacity;
+
+	if (bytes < have * 2)
+		bytes = have * 2;
+	unsigned char *data = realloc(set->data, bytes);
+	if (!data)
+		return 0;
+	set->data = data;
+	set->capacity = bitset_internal_capacity(bytes);
+	return set->capacity;
+}
+
+/* bitset_append(dst, src)
+ |   appends the bits of src to the end of dst, growing dst with
+ |   bitset_reserve. Whole words of src are shifted into place and
+ |   merged with the carry of the previous word; src may be dst;
+ |   returns the number of bits appended, or 0 if memory could not be
+ |   allocated (dst is left unchanged)
+ | dst: valid pointer to a [struct bitset]
+ | src: valid pointer to a [struct bitset]
+ */
+size_t bitset_append(struct bitset *dst, struct bitset *src)
+{
+	size_t num = src->size;
+	size_t pos = dst->size;
+	if (!num)
+		return 0;
+	if (!bitset_reserve(dst, pos + num))
+		return 0;
+	if (dst->flags & BITSET_COUNTED)
+		dst->count += bitset_count(src);
+
+	unsigned int shift = pos & 0x7;
+	unsigned char *out = dst->data + (pos >> 3);
+	size_t bytes = bitset_internal_bytes(shift + num);
+	size_t words = bitset_internal_words(num);
+	uint64_t carry = shift ? *out & ~(~0U << shift) : 0;
+
+	for (size_t i = 0; i < words; ++i) {
+		uint64_t word = bitset_word(src, i);
+		size_t rest = bytes - (i << 3);
+		bitset_internal_store(out + (i << 3), word << shift | carry,
+		                      rest < 8 ? rest : 8);
+		carry = shift ? word >> (64 - shift) : 0;
+	}
+	if (bytes > words << 3)
+		out[words << 3] = carry;
+
+	dst->size = pos + num;
+	bitset_prefix_resize(dst, pos);
+	return num;
+}
+
+/* bitset_concat(dst, a, b)
+ |   replaces the contents of dst with the bits of a followed by the
+ |   bits of b; dst may be a or b;
+ |   returns the new size of dst, or 0 if memory could not be allocated
+ | dst: valid pointer to a [struct bitset]
+ | a:   valid pointer to a [struct bitset]
+ | b:   valid pointer to a [struct bitset]
+ */
+size_t bitset_concat(struct bitset *dst, struct bitset *a, struct bitset *b)
+{
+	size_t size = a->size + b->size;
+	if (!size) {
+		dst->size = 0;
+		dst->count = 0;
+		return 0;
+	}
+	if (!bitset_reserve(dst, size))
+		return 0;
+	if (dst == a) {
+		bitset_append(dst, b);
+		return dst->size;
+	}
+
+	struct bitset tail = *b;
+	int copy = dst == b && b->size;
+	if (copy) {
+		/* b is overwritten by a, append from a copy */
+		tail.data = malloc(bitset_internal_bytes(b->size));
+		if (!tail.data)
+			return 0;
+		memcpy(tail.data, b->data, bitset_internal_bytes(b->size));
+	}
+
+	dst->size = 0;
+	dst->count = 0;
+	bitset_append(dst, a);
+	bitset_append(dst, &tail);
+	if (copy)
+		free(tail.data);
+	return dst->size;
+}
+
 /* bitset_byte_at(set, index):
  |   returns a pointer to the byte that contains the bit at the specified index
  | set:   valid pointer to a [struct bitset]
@@ -142,7 +403,8 @@ unsigned char *bitset_byte_at(struct bitset *set, size_t index)
 }
 
 /* bitset_set(set, index, state):
- |   sets a bit to the specified state
+ |   sets a bit to the specified state; a cached count is adjusted by
+ |   the difference to the old state
  | set:   valid pointer to a [struct bitset]
  | index: the offset of the bit in the bitset
  | state: a boolean value expressing the specified bit's new state
@@ -150,6 +412,13 @@ unsigned char *bitset_byte_at(struct bitset *set, size_t index)
 void bitset_set(struct bitset *set, size_t index, unsigned int state)
 {
 	unsigned char *entry = bitset_byte_at(set, index);
+	if (set->flags & (BITSET_COUNTED | BITSET_RANKED)) {
+		size_t delta = !!state - !!(*entry & (1 << (index & 0x7)));
+		if (set->flags & BITSET_COUNTED)
+			set->count += delta;
+		if (set->flags & BITSET_RANKED)
+			bitset_tree_add(set, index / BITSET_RANKED_BLOCK, delta);
+	}
 	*entry ^= (-!!state ^ *entry) & (1 << (index & 0x7));
 }
 
@@ -178,6 +447,10 @@ size_t bitset_write(struct bitset *set, size_t index,
 	unsigned int shift = index & 0x7;
 	register unsigned int mask = ~0 << shift;
 	unsigned char *entry = bitset_byte_at(set, index);
+	if (set->flags & BITSET_COUNTED)
+		set->count -= bitset_rcount(set, index, index + size);
+	int local = !(set->flags & BITSET_RANKED) ||
+	            bitset_tree_range(set, index, index + size, -1);
 
 	for (; size >> 3; size -= 8, ++seq) {
 		*entry &= ~mask;
@@ -203,6 +476,12 @@ size_t bitset_write(struct bitset *set, size_t index,
 		}
 	}
 
+	if (set->flags & BITSET_COUNTED)
+		set->count += bitset_rcount(set, index, index + tmp);
+	if (!local)
+		bitset_tree_build(set);
+	else if (set->flags & BITSET_RANKED)
+		bitset_tree_range(set, index, index + tmp, 1);
 	return tmp;
 }
 
@@ -244,3 +523,534 @@ size_t bitset_read(struct bitset *set, size_t index,
 
 	return tmp;
 }
+
+/* bitset_word(set, index):
+ |   returns the 64 bits starting at bit (index * 64) as a word,
+ |   with bit i of the word being bit (index * 64 + i) of the bitset;
+ |   bits at or beyond the size of the bitset read as zero
+ | set:   valid pointer to a [struct bitset]
+ | index: the index of the word
+ */
+uint64_t bitset_word(struct bitset *set, size_t index)
+{
+	size_t offset = index << 6;
+	if (offset >= set->size)
+		return 0;
+
+	size_t rest = set->size - offset;
+	uint64_t word = bitset_internal_load(set->data + (index << 3),
+	                                     bitset_internal_bytes(rest));
+	if (rest < 64)
+		word &= ~(~(uint64_t)0 << rest);
+	return word;
+}
+
+/* mixes a single word and its position into an independent 64-bit value;
+ | bijective in the word for a fixed position and seed */
+static inline
+uint64_t bitset_hash_mix(uint64_t word, uint64_t index, uint64_t seed)
+{
+	uint64_t x = (word ^ seed) * 0x9e3779b97f4a7c15ULL;
+	x += (index + 1) * 0xc2b2ae3d27d4eb4fULL;
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+/* bitset_hash(set, seed):
+ |   computes a 64-bit hash over the bits 0 to (size - 1); bits beyond
+ |   the size do not contribute. Every word is mixed independently and
+ |   the results are summed, which keeps the loop free of dependencies
+ |   between words and allows bitset_hash_update. The result is the
+ |   same on every platform for equal contents, size and seed;
+ |   returns the hash
+ | set:  valid pointer to a [struct bitset]
+ | seed: arbitrary value to select a different hash function
+ */
+uint64_t bitset_hash(struct bitset *set, uint64_t seed)
+{
+	size_t words = set->size >> 6;
+	uint64_t hash = bitset_hash_mix(set->size, ~(uint64_t)0, seed);
+	const unsigned char *data = set->data;
+
+	for (size_t i = 0; i < words; ++i, data += 8)
+		hash += bitset_hash_mix(bitset_internal_load(data, 8), i, seed);
+	if (set->size & 0x3f)
+		hash += bitset_hash_mix(bitset_word(set, words), words, seed);
+
+	return hash;
+}
+
+/* bitset_hash_update(hash, seed, index, old_word, new_word):
+ |   updates a hash previously computed by bitset_hash after a single
+ |   word of the bitset changed, without rehashing the other words;
+ |   the size of the bitset must not have changed;
+ |   returns the hash of the modified bitset
+ | hash:     the previous hash
+ | seed:     the seed the previous hash was computed with
+ | index:    the index of the modified word, as for bitset_word
+ | old_word: bitset_word(set, index) before the modification
+ | new_word: bitset_word(set, index) after the modification
+ */
+uint64_t bitset_hash_update(uint64_t hash, uint64_t seed, size_t index,
+                            uint64_t old_word, uint64_t new_word)
+{
+	return hash - bitset_hash_mix(old_word, index, seed)
+	            + bitset_hash_mix(new_word, index, seed);
+}
+
+/* bitset_count(set):
+ |   returns the number of set bits: 0 to (size - 1); constant time
+ |   if the count is cached
+ | set: valid pointer to a [struct bitset]
+ */
+size_t bitset_count(struct bitset *set)
+{
+	if (set->flags & BITSET_COUNTED)
+		return set->count;
+	return bitset_rcount(set, 0, set->size);
+}
+
+/* bitset_count_cache(set, enable):
+ |   turns the cached count on or off. While it is on, every function
+ |   that modifies the set keeps the count up to date: single bits by
+ |   the change of their state, ranges by counting them before and
+ |   after. Code that writes to set->data directly has to call
+ |   bitset_recount afterwards;
+ |   returns the number of set bits
+ | set:    valid pointer to a [struct bitset]
+ | enable: flag that indicates if the count should be cached
+ */
+size_t bitset_count_cache(struct bitset *set, unsigned int enable)
+{
+	set->flags &= ~BITSET_COUNTED;
+	set->count = bitset_count(set);
+	if (enable)
+		set->flags |= BITSET_COUNTED;
+	return set->count;
+}
+
+/* bitset_recount(set):
+ |   recounts the set bits if the count is cached and rebuilds the rank
+ |   tree if there is one, also after the size has changed;
+ |   returns 1 on success, 0 if memory for the tree could not be
+ |   allocated (the tree is dropped)
+ | set: valid pointer to a [struct bitset]
+ */
+int bitset_recount(struct bitset *set)
+{
+	if (set->flags & BITSET_COUNTED)
+		set->count = bitset_rcount(set, 0, set->size);
+	if (set->flags & BITSET_RANKED)
+		return bitset_tree_build(set);
+	return 1;
+}
+
+/* bitset_prefix_cache(set, enable):
+ |   turns the rank tree on or off: a Fenwick tree over the counts of
+ |   BITSET_RANKED_BLOCK bits, kept up to date by bitset_set in O(log n)
+ |   and by the range functions block by block. It is meant for sets of
+ |   a fixed size, functions that change the size rebuild it. Unlike the
+ |   static index of rank.h it follows every change of the set;
+ |   returns 1 on success, 0 if memory could not be allocated
+ | set:    valid pointer to a [struct bitset]
+ | enable: flag that indicates if the tree should be kept
+ */
+int bitset_prefix_cache(struct bitset *set, unsigned int enable)
+{
+	if (!enable) {
+		free(set->ranks);
+		set->ranks = NULL;
+		set->flags &= ~BITSET_RANKED;
+		return 1;
+	}
+	if (!bitset_tree_build(set))
+		return 0;
+	set->flags |= BITSET_RANKED;
+	return 1;
+}
+
+/* bitset_prefix_resize(set, old):
+ |   brings the rank tree up to date after the size was changed from
+ |   old, for code that resizes the struct itself. A grown set only has
+ |   its new blocks added, in O(log n) each, so growing bit by bit stays
+ |   linear; a shrunk set has its tree rebuilt;
+ |   returns 1 on success, 0 if memory could not be allocated (the tree
+ |   is dropped)
+ | set: valid pointer to a [struct bitset]
+ | old: size of the set when the tree was last up to date
+ */
+int bitset_prefix_resize(struct bitset *set, size_t old)
+{
+	if (!(set->flags & BITSET_RANKED))
+		return 1;
+	if (set->size < old)
+		return bitset_tree_build(set);
+
+	size_t from = bitset_tree_blocks(old);
+	size_t num = bitset_tree_blocks(set->size);
+	if (bitset_tree_capacity(num) != bitset_tree_capacity(from)) {
+		size_t *ranks = realloc(set->ranks,
+		                        bitset_tree_capacity(num) * sizeof(size_t));
+		if (!ranks) {
+			free(set->ranks);
+			set->ranks = NULL;
+			set->flags &= ~BITSET_RANKED;
+			return 0;
+		}
+		set->ranks = ranks;
+	}
+
+	/* the last old block only counted the bits below old; no other
+	 | entry of the old tree covers it */
+	if (from)
+		set->ranks[from] += bitset_rcount(set, old,
+		                                  from * BITSET_RANKED_BLOCK);
+	/* entry i covers the blocks after i - (i & -i) up to i */
+	for (size_t i = from + 1; i <= num; ++i)
+		set->ranks[i] = bitset_rcount(set, (i - 1) * BITSET_RANKED_BLOCK,
+		                              i * BITSET_RANKED_BLOCK) +
+		                bitset_tree_sum(set, i - 1) -
+		                bitset_tree_sum(set, i - (i & -i));
+	return 1;
+}
+
+/* bitset_prefix_count(set, index):
+ |   returns the number of set bits before the specified index, in
+ |   O(log n) with the rank tree and by counting the prefix otherwise
+ | set:   valid pointer to a [struct bitset]
+ | index: position up to which to count (exclusive), at most the size
+ */
+size_t bitset_prefix_count(struct bitset *set, size_t index)
+{
+	if (!(set->flags & BITSET_RANKED))
+		return bitset_rcount(set, 0, index);
+
+	size_t block = index / BITSET_RANKED_BLOCK;
+	return bitset_tree_sum(set, block) +
+	       bitset_rcount(set, block * BITSET_RANKED_BLOCK, index);
+}
+
+/* bitset_prefix_select(set, k):
+ |   returns the position of the set bit with rank k (counting from 0),
+ |   or SIZE_MAX if there are not more than k set bits. With the rank
+ |   tree the block is found by descending the tree in O(log n), the
+ |   bit by scanning the words of that block
+ | set: valid pointer to a [struct bitset]
+ | k:   number of set bits preceding the bit to find
+ */
+size_t bitset_prefix_select(struct bitset *set, size_t k)
+{
+	size_t w = 0;
+	if (set->flags & BITSET_RANKED) {
+		size_t num = bitset_tree_blocks(set->size);
+		size_t pos = 0, step = 1;
+		while (step <= num / 2)
+			step <<= 1;
+		for (; step && num; step >>= 1)
+			if (pos + step <= num && set->ranks[pos + step] <= k) {
+				pos += step;
+				k -= set->ranks[pos];
+			}
+		w = pos * (BITSET_RANKED_BLOCK / 64);
+	}
+
+	for (size_t words = bitset_internal_words(set->size); w < words; ++w) {
+		uint64_t word = bitset_word(set, w);
+		size_t count = bitset_internal_popcount(word);
+		if (k < count)
+			return (w << 6) + bitset_internal_select(word, k);
+		k -= count;
+	}
+	return SIZE_MAX;
+}
+
+/* bitset_rcount(set, begin, end):
+ |   returns the number of set bits inside the given range:
+ |   begin to (end - 1); bits at or beyond the size count as zero
+ | set:   valid pointer to a [struct bitset]
+ | begin: index of the first bit (inclusive)
+ | end:   index of the ending bit (exclusive)
+ */
+size_t bitset_rcount(struct bitset *set, size_t begin, size_t end)
+{
+	if (end > set->size)
+		end = set->size;
+	if (begin >= end)
+		return 0;
+
+	size_t first = begin >> 6;
+	size_t last = (end - 1) >> 6;
+	uint64_t head = ~(uint64_t)0 << (begin & 0x3f);
+	uint64_t tail = ~(uint64_t)0 >> (63 - ((end - 1) & 0x3f));
+
+	if (first == last)
+		return bitset_internal_popcount(bitset_word(set, first) & head & tail);
+
+	size_t count = bitset_internal_popcount(bitset_word(set, first) & head);
+	const unsigned char *data = set->data + ((first + 1) << 3);
+	for (size_t i = first + 1; i < last; ++i, data += 8)
+		count += bitset_internal_popcount(bitset_internal_load(data, 8));
+	return count + bitset_internal_popcount(bitset_word(set, last) & tail);
+}
+
+/* bitset_rng_seed(rng, seed):
+ |   initializes a random number generator from a single value
+ | rng:  pointer to a [struct bitset_rng]
+ | seed: arbitrary value
+ */
+void bitset_rng_seed(struct bitset_rng *rng, uint64_t seed)
+{
+	/* expand the seed with splitmix64 */
+	for (int i = 0; i < 4; ++i) {
+		uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		rng->s[i] = z ^ (z >> 31);
+	}
+}
+
+/* bitset_rng_next(rng):
+ |   returns 64 uniformly distributed random bits
+ | rng: valid pointer to a seeded [struct bitset_rng]
+ */
+uint64_t bitset_rng_next(struct bitset_rng *rng)
+{
+	uint64_t *s = rng->s;
+	uint64_t x = s[1] * 5;
+	uint64_t result = ((x << 7) | (x >> 57)) * 9;
+	uint64_t t = s[1] << 17;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = (s[3] << 45) | (s[3] >> 19);
+	return result;
+}
+
+/* returns a uniformly distributed value in [0, bound) */
+static
+uint64_t bitset_rng_below(struct bitset_rng *rng, uint64_t bound)
+{
+	uint64_t threshold = -bound % bound;
+	uint64_t x;
+	do
+		x = bitset_rng_next(rng);
+	while (x < threshold);
+	return x % bound;
+}
+
+/* bitset_sample(set, k, rng, positions):
+ |   picks k distinct set bits uniformly at random. The ranks of the
+ |   picked bits are drawn with Floyd's algorithm into a scratch bitset
+ |   and resolved to positions in a single pass over word popcounts;
+ |   returns the number of positions written - min(k, bitset_count(set)),
+ |   in ascending order
+ | set:       valid pointer to a [struct bitset]
+ | k:         number of bits to pick
+ | rng:       valid pointer to a seeded [struct bitset_rng]
+ | positions: pointer to memory for k indices
+ */
+size_t bitset_sample(struct bitset *set, size_t k, struct bitset_rng *rng,
+                     size_t *positions)
+{
+	size_t count = bitset_count(set);
+	size_t words = bitset_internal_words(set->size);
+	size_t num = 0;
+
+	if (k >= count) {
+		for (size_t i = 0; i < words; ++i)
+			for (uint64_t w = bitset_word(set, i); w; w &= w - 1)
+				positions[num++] = (i << 6) + bitset_internal_ctz(w);
+		return num;
+	}
+	if (!k)
+		return 0;
+
+	struct bitset *ranks = bitset_calloc(count);
+	if (!ranks)
+		return 0;
+	for (size_t j = count - k; j < count; ++j) {
+		size_t t = bitset_rng_below(rng, j + 1);
+		bitset_set(ranks, bitset_get(ranks, t) ? j : t, 1);
+	}
+
+	/* merge the sorted ranks with the running popcount of the set */
+	size_t i = 0, seen = 0;
+	uint64_t word = bitset_word(set, 0);
+	size_t pc = bitset_internal_popcount(word);
+	for (size_t r = 0; r < bitset_internal_words(count); ++r) {
+		for (uint64_t w = bitset_word(ranks, r); w; w &= w - 1) {
+			size_t rank = (r << 6) + bitset_internal_ctz(w);
+			while (rank >= seen + pc) {
+				seen += pc;
+				word = bitset_word(set, ++i);
+				pc = bitset_internal_popcount(word);
+			}
+			positions[num++] = (i << 6) +
+				bitset_internal_select(word, rank - seen);
+		}
+	}
+
+	bitset_free(ranks);
+	return num;
+}
+
+/* bitset_random(set, p, rng):
+ |   sets every bit independently with probability p and clears it
+ |   otherwise. Each word is built by combining random words with AND
+ |   and OR along the binary expansion of p (32 bits of precision), so
+ |   a word takes at most 32 draws and p = 0.5 takes exactly one;
+ |   returns the number of bits written - that is the size of the set
+ | set: valid pointer to a [struct bitset]
+ | p:   probability of a bit being set
+ | rng: valid pointer to a seeded [struct bitset_rng]
+ */
+size_t bitset_random(struct bitset *set, double p, struct bitset_rng *rng)
+{
+	/* p just below 1 rounds to 2^32, which does not fit the cast */
+	double scaled = p * 4294967296.0 + 0.5;
+	uint32_t frac = !(p > 0.0) ? 0 : scaled >= 4294967295.0 ? UINT32_MAX
+	              : (uint32_t)scaled;
+	size_t bytes = set->size ? bitset_internal_bytes(set->size) : 0;
+
+	for (size_t i = 0; i < bytes; i += 8) {
+		uint64_t word;
+		if (!frac)
+			word = 0;
+		else if (frac == UINT32_MAX)
+			word = ~(uint64_t)0;
+		else {
+			/* least significant digit first: a 1 ORs in a fresh
+			 | word, a 0 ANDs one in, halving or doubling the gap */
+			unsigned int bit = bitset_internal_ctz(frac);
+			word = bitset_rng_next(rng);
+			while (++bit < 32) {
+				if (frac >> bit & 1)
+					word |= bitset_rng_next(rng);
+				else
+					word &= bitset_rng_next(rng);
+			}
+		}
+		bitset_internal_store(set->data + i, word,
+		                      bytes - i < 8 ? bytes - i : 8);
+	}
+
+	bitset_recount(set);
+	return set->size;
+}
+
+/* bitset_reverse(set):
+ |   reverses the order of the bits 0 to (size - 1) in place, so that
+ |   bit i becomes bit (size - 1 - i). Whole words are swapped from
+ |   both ends with their bits reversed, then everything is shifted
+ |   down by the padding of the last byte;
+ |   returns the number of bits reversed - that is the size of the set
+ | set: valid pointer to a [struct bitset]
+ */
+size_t bitset_reverse(struct bitset *set)
+{
+	if (!set->size)
+		return 0;
+
+	unsigned char *data = set->data;
+	size_t bytes = bitset_internal_bytes(set->size);
+	size_t i = 0, j = bytes;
+
+	for (; j - i >= 16; i += 8, j -= 8) {
+		uint64_t lo = bitset_internal_load(data + i, 8);
+		uint64_t hi = bitset_internal_load(data + j - 8, 8);
+		bitset_internal_store(data + i, bitset_internal_rev64(hi), 8);
+		bitset_internal_store(data + j - 8, bitset_internal_rev64(lo), 8);
+	}
+	for (; j - i >= 2; ++i, --j) {
+		unsigned char lo = bitset_internal_rev8x8(data[i]);
+		data[i] = bitset_internal_rev8x8(data[j - 1]);
+		data[j - 1] = lo;
+	}
+	if (j > i)
+		data[i] = bitset_internal_rev8x8(data[i]);
+
+	/* the padding bits of the last byte are now at the front */
+	unsigned int pad = (bytes << 3) - set->size;
+	if (pad) {
+		for (i = 0; i + 8 < bytes; i += 8) {
+			uint64_t word = bitset_internal_load(data + i, 8) >> pad;
+			word |= (uint64_t)data[i + 8] << (64 - pad);
+			bitset_internal_store(data + i, word, 8);
+		}
+		bitset_internal_store(data + i,
+			bitset_internal_load(data + i, bytes - i) >> pad, bytes - i);
+	}
+	bitset_recount(set);
+	return set->size;
+}
+
+/* bitset_from_msb_first(set, seq, size):
+ |   copies a bit sequence that stores the first bit of every byte in
+ |   its most significant bit into the bitset, starting at bit 0; the
+ |   bits of every byte are reversed eight bytes at a time. The bits of
+ |   the set at or beyond size are kept, unless seq is the data of the
+ |   set itself to convert in place, which reverses the last byte whole;
+ |   returns the number of bits copied - that is the size argument
+ | set:  valid pointer to a [struct bitset] holding at least size bits
+ | seq:  pointer to the MSB-first bit sequence
+ | size: the amount of bits to copy
+ */
+size_t bitset_from_msb_first(struct bitset *set, const unsigned char *seq,
+                             size_t size)
+{
+	size_t bytes = size ? bitset_internal_bytes(size) : 0;
+	size_t i = 0;
+	/* the bits of the last byte at or beyond size, LSB first */
+	unsigned char keep = seq == set->data ? 0 : ~0U << (size & 0x7);
+	unsigned char old = bytes ? set->data[bytes - 1] : 0;
+	for (; i + 8 <= bytes; i += 8)
+		bitset_internal_store(set->data + i,
+			bitset_internal_rev8x8(bitset_internal_load(seq + i, 8)), 8);
+	if (i < bytes)
+		bitset_internal_store(set->data + i,
+			bitset_internal_rev8x8(bitset_internal_load(seq + i, bytes - i)),
+			bytes - i);
+	if (keep && (size & 0x7))
+		set->data[bytes - 1] = (old & keep) | (set->data[bytes - 1] & ~keep);
+	bitset_recount(set);
+	return size;
+}
+
+/* bitset_to_msb_first(set, seq, size):
+ |   copies the bits 0 to (size - 1) into a bit sequence that stores the
+ |   first bit of every byte in its most significant bit. The bits of
+ |   seq after the first size are kept, unless seq is the data of the
+ |   set itself to convert in place, which reverses the last byte whole;
+ |   returns the number of bits copied - that is the size argument
+ | set:  valid pointer to a [struct bitset] holding at least size bits
+ | seq:  pointer to memory for (size + 7) / 8 bytes
+ | size: the amount of bits to copy
+ */
+size_t bitset_to_msb_first(struct bitset *set, unsigned char *seq,
+                           size_t size)
+{
+	size_t bytes = size ? bitset_internal_bytes(size) : 0;
+	size_t i = 0;
+	/* the bits of the last byte after the first size, MSB first */
+	unsigned char keep = seq == set->data ? 0 : 0xffU >> (size & 0x7);
+	unsigned char old = bytes ? seq[bytes - 1] : 0;
+	for (; i + 8 <= bytes; i += 8)
+		bitset_internal_store(seq + i,
+			bitset_internal_rev8x8(bitset_internal_load(set->data + i, 8)), 8);
+	if (i < bytes)
+		bitset_internal_store(seq + i,
+			bitset_internal_rev8x8(bitset_internal_load(set->data + i, bytes - i)),
+			bytes - i);
+	if (keep && (size & 0x7))
+		seq[bytes - 1] = (old & keep) | (seq[bytes - 1] & ~keep);
+	/* converted in place */
+	if (seq == set->data)
+		bitset_recount(set);
+	return size;
+}
@@ -19,6 +19,21 @@ struct bitset {
 	unsigned char *data;
 	size_t capacity;
 	size_t size;
+	size_t count;
+	size_t *ranks;
+	unsigned int flags;
+};
+
+/* flags of a [struct bitset] */
+#define BITSET_COUNTED 0x1 /* count holds the number of set bits */
+#define BITSET_RANKED  0x2 /* ranks holds a Fenwick tree of block counts */
+
+/* bits covered by one count of the Fenwick tree */
+#define BITSET_RANKED_BLOCK 512
+
+/* xoshiro256** state used by the randomized functions */
+struct bitset_rng {
+	uint64_t s[4];
 };
 
 /* bitset_bytes(set)
@@ -50,6 +65,21 @@ size_t bitset_nclear(struct bitset *set, size_t index, size_t size)
 	return bitset_rclear(set, index, index + size);
 }
 
+size_t bitset_rset(struct bitset *set, size_t begin, size_t end);
+
+/* bitset_nset(set, index, size)
+ |   sets the specified number of bits: index to (index + size - 1);
+ |   returns the number of bits set
+ | set:   valid pointer to a [struct bitset]
+ | index: index of the first bit (inclusive)
+ | size:  number of bits to be set
+ */
+static inline
+size_t bitset_nset(struct bitset *set, size_t index, size_t size)
+{
+	return bitset_rset(set, index, index + size);
+}
+
 /* bitset_clear(set)
  |   clears all bits: 0 to (size - 1);
  |   returns the number of bits cleared
@@ -59,11 +89,18 @@ static inline
 size_t bitset_clear(struct bitset *set)
 {
 	memset(set->data, 0, bitset_bytes(set));
+	set->count = 0;
+	if (set->flags & BITSET_RANKED)
+		memset(set->ranks, 0, ((set->size + BITSET_RANKED_BLOCK - 1) /
+		                       BITSET_RANKED_BLOCK + 1) * sizeof(size_t));
 	return set->size;
 }
 
 intmax_t bitset_resize(struct bitset *set, size_t size);
 intmax_t bitset_cresize(struct bitset *set, size_t size);
+size_t bitset_reserve(struct bitset *set, size_t size);
+size_t bitset_append(struct bitset *dst, struct bitset *src);
+size_t bitset_concat(struct bitset *dst, struct bitset *a, struct bitset *b);
 
 unsigned char *bitset_byte_at(struct bitset *set, size_t index);
 void bitset_set(struct bitset *set, size_t index, unsigned int state);
@@ -73,6 +110,33 @@ size_t bitset_write(struct bitset *set, size_t index,
 size_t bitset_read(struct bitset *set, size_t index,
                    unsigned char *seq, size_t size);
 
+uint64_t bitset_word(struct bitset *set, size_t index);
+uint64_t bitset_hash(struct bitset *set, uint64_t seed);
+uint64_t bitset_hash_update(uint64_t hash, uint64_t seed, size_t index,
+                            uint64_t old_word, uint64_t new_word);
+
+size_t bitset_count(struct bitset *set);
+size_t bitset_count_cache(struct bitset *set, unsigned int enable);
+int bitset_recount(struct bitset *set);
+
+int bitset_prefix_cache(struct bitset *set, unsigned int enable);
+int bitset_prefix_resize(struct bitset *set, size_t old);
+size_t bitset_prefix_count(struct bitset *set, size_t index);
+size_t bitset_prefix_select(struct bitset *set, size_t k);
+size_t bitset_rcount(struct bitset *set, size_t begin, size_t end);
+
+void bitset_rng_seed(struct bitset_rng *rng, uint64_t seed);
+uint64_t bitset_rng_next(struct bitset_rng *rng);
+size_t bitset_sample(struct bitset *set, size_t k, struct bitset_rng *rng,
+                     size_t *positions);
+size_t bitset_random(struct bitset *set, double p, struct bitset_rng *rng);
+
+size_t bitset_reverse(struct bitset *set);
+size_t bitset_from_msb_first(struct bitset *set, const unsigned char *seq,
+                             size_t size);
+size_t bitset_to_msb_first(struct bitset *set, unsigned char *seq,
+                           size_t size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,498 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef BITSET_HPP
+#define BITSET_HPP
+
+#if __cplusplus < 202002L
+#error "bitset.hpp requires C++20"
+#endif
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+
+#include "bitset.h"
+
+namespace bitsets {
+
+inline constexpr std::size_t npos = SIZE_MAX;
+
+namespace detail {
+
+/* next(set, from, value)
+ |   returns the first position at or after from whose bit equals
+ |   value, or the size if there is none; whole words without such a
+ |   bit are skipped with one test each
+ */
+inline std::size_t next(struct bitset *set, std::size_t from, bool value) noexcept
+{
+	std::size_t size = set->size;
+	if (from >= size)
+		return size;
+
+	std::size_t w = from >> 6;
+	std::uint64_t flip = value ? 0 : ~std::uint64_t(0);
+	std::uint64_t word = (bitset_word(set, w) ^ flip) &
+	                     (~std::uint64_t(0) << (from & 0x3f));
+	while (!word) {
+		if (++w << 6 >= size)
+			return size;
+		word = bitset_word(set, w) ^ flip;
+	}
+	std::size_t pos = (w << 6) + std::countr_zero(word);
+	return pos < size ? pos : size;
+}
+
+/* prev(set, before, value)
+ |   returns the last position before the passed one whose bit equals
+ |   value, or npos if there is none
+ */
+inline std::size_t prev(struct bitset *set, std::size_t before, bool value) noexcept
+{
+	if (!before)
+		return npos;
+
+	std::size_t last = before - 1;
+	std::size_t w = last >> 6;
+	std::uint64_t flip = value ? 0 : ~std::uint64_t(0);
+	std::uint64_t word = (bitset_word(set, w) ^ flip) &
+	                     (~std::uint64_t(0) >> (63 - (last & 0x3f)));
+	while (!word) {
+		if (!w--)
+			return npos;
+		word = bitset_word(set, w) ^ flip;
+	}
+	return (w << 6) + 63 - std::countl_zero(word);
+}
+
+} // namespace detail
+
+/* bidirectional iterator over the positions of the bits equal to Value;
+ | the end iterator is at the size of the set */
+template <bool Value>
+class position_iterator {
+public:
+	using iterator_concept = std::bidirectional_iterator_tag;
+	using iterator_category = std::input_iterator_tag;
+	using value_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+
+	position_iterator() = default;
+	position_iterator(struct bitset *set, std::size_t pos) noexcept
+		: set_(set), pos_(pos) {}
+
+	std::size_t operator*() const noexcept { return pos_; }
+
+	position_iterator &operator++() noexcept
+	{
+		pos_ = detail::next(set_, pos_ + 1, Value);
+		return *this;
+	}
+
+	position_iterator operator++(int) noexcept
+	{
+		position_iterator tmp = *this;
+		++*this;
+		return tmp;
+	}
+
+	position_iterator &operator--() noexcept
+	{
+		pos_ = detail::prev(set_, pos_, Value);
+		return *this;
+	}
+
+	position_iterator operator--(int) noexcept
+	{
+		position_iterator tmp = *this;
+		--*this;
+		return tmp;
+	}
+
+	friend bool operator==(const position_iterator &a,
+	                       const position_iterator &b) noexcept
+	{
+		return a.pos_ == b.pos_;
+	}
+
+private:
+	struct bitset *set_ = nullptr;
+	std::size_t pos_ = 0;
+};
+
+/* view of the positions of the bits equal to Value; it refers to the
+ | set, which must not be resized while the view is iterated */
+template <bool Value>
+class position_view : public std::ranges::view_interface<position_view<Value>> {
+public:
+	using iterator = position_iterator<Value>;
+
+	position_view() = default;
+	explicit position_view(struct bitset *set) noexcept : set_(set) {}
+
+	iterator begin() const noexcept
+	{
+		return iterator(set_, detail::next(set_, 0, Value));
+	}
+
+	iterator end() const noexcept { return iterator(set_, set_->size); }
+
+private:
+	struct bitset *set_ = nullptr;
+};
+
+using ones_view = position_view<true>;
+using zeros_view = position_view<false>;
+
+/* ones(set)
+ |   returns a view of the positions of the set bits, ascending
+ | set: valid pointer to a [struct bitset]
+ */
+inline ones_view ones(struct bitset *set) noexcept { return ones_view(set); }
+
+/* zeros(set)
+ |   returns a view of the positions of the cleared bits, ascending
+ | set: valid pointer to a [struct bitset]
+ */
+inline zeros_view zeros(struct bitset *set) noexcept { return zeros_view(set); }
+
+/* maximal range of set bits: begin to (end - 1) */
+struct run {
+	std::size_t begin;
+	std::size_t end;
+
+	friend bool operator==(const run &, const run &) = default;
+};
+
+/* bidirectional iterator over the runs of set bits; the end iterator
+ | is the empty run at the size of the set */
+class run_iterator {
+public:
+	using iterator_concept = std::bidirectional_iterator_tag;
+	using iterator_category = std::input_iterator_tag;
+	using value_type = run;
+	using difference_type = std::ptrdiff_t;
+
+	run_iterator() = default;
+	run_iterator(struct bitset *set, std::size_t begin) noexcept
+		: set_(set), run_{begin, detail::next(set, begin, false)} {}
+
+	run operator*() const noexcept { return run_; }
+
+	run_iterator &operator++() noexcept
+	{
+		run_.begin = detail::next(set_, run_.end, true);
+		run_.end = detail::next(set_, run_.begin, false);
+		return *this;
+	}
+
+	run_iterator operator++(int) noexcept
+	{
+		run_iterator tmp = *this;
+		++*this;
+		return tmp;
+	}
+
+	run_iterator &operator--() noexcept
+	{
+		std::size_t last = detail::prev(set_, run_.begin, true);
+		std::size_t gap = detail::prev(set_, last, false);
+		run_.end = last + 1;
+		run_.begin = gap == npos ? 0 : gap + 1;
+		return *this;
+	}
+
+	run_iterator operator--(int) noexcept
+	{
+		run_iterator tmp = *this;
+		--*this;
+		return tmp;
+	}
+
+	friend bool operator==(const run_iterator &a, const run_iterator &b) noexcept
+	{
+		return a.run_.begin == b.run_.begin;
+	}
+
+private:
+	struct bitset *set_ = nullptr;
+	run run_ = {0, 0};
+};
+
+/* view of the runs of set bits, in ascending order */
+class runs_view : public std::ranges::view_interface<runs_view> {
+public:
+	using iterator = run_iterator;
+
+	runs_view() = default;
+	explicit runs_view(struct bitset *set) noexcept : set_(set) {}
+
+	iterator begin() const noexcept
+	{
+		return iterator(set_, detail::next(set_, 0, true));
+	}
+
+	iterator end() const noexcept { return iterator(set_, set_->size); }
+
+private:
+	struct bitset *set_ = nullptr;
+};
+
+/* runs(set)
+ |   returns a view of the runs of set bits
+ | set: valid pointer to a [struct bitset]
+ */
+inline runs_view runs(struct bitset *set) noexcept { return runs_view(set); }
+
+/* dynamic bitset whose memory comes from an allocator of bytes; it owns
+ | a [struct bitset], which c_bitset() passes to the C functions. Those
+ | that reallocate the data (bitset_resize, bitset_cresize,
+ | bitset_reserve, bitset_append, bitset_concat and the parse
+ | functions) must not be used on it, the member functions grow it.
+ | Only the data is allocated through the allocator: the rank tree of
+ | bitset_prefix_cache, if turned on, is owned by the C core and comes
+ | from malloc */
+template <class Allocator = std::allocator<unsigned char>>
+class basic_bitset {
+	using traits = std::allocator_traits<Allocator>;
+	static_assert(std::is_same_v<typename traits::value_type, unsigned char>,
+	              "the allocator must allocate unsigned char");
+
+public:
+	using allocator_type = Allocator;
+	using size_type = std::size_t;
+
+	basic_bitset() noexcept(noexcept(Allocator())) : basic_bitset(Allocator()) {}
+
+	explicit basic_bitset(const Allocator &alloc) noexcept : alloc_(alloc) {}
+
+	/* creates size cleared bits */
+	explicit basic_bitset(size_type size, const Allocator &alloc = Allocator())
+		: alloc_(alloc)
+	{
+		resize(size);
+	}
+
+	basic_bitset(const basic_bitset &other)
+		: basic_bitset(other,
+		  traits::select_on_container_copy_construction(other.alloc_)) {}
+
+	basic_bitset(const basic_bitset &other, const Allocator &alloc)
+		: alloc_(alloc)
+	{
+		assign_bits(other);
+	}
+
+	basic_bitset(basic_bitset &&other) noexcept
+		: alloc_(std::move(other.alloc_)), set_(other.set_)
+	{
+		other.set_ = {};
+	}
+
+	~basic_bitset() { release(); }
+
+	basic_bitset &operator=(const basic_bitset &other)
+	{
+		if (this == &other)
+			return *this;
+		if constexpr (traits::propagate_on_container_copy_assignment::value) {
+			if (alloc_ != other.alloc_) {
+				release();
+				set_ = {};
+			}
+			alloc_ = other.alloc_;
+		}
+		assign_bits(other);
+		return *this;
+	}
+
+	basic_bitset &operator=(basic_bitset &&other) noexcept(
+		traits::propagate_on_container_move_assignment::value ||
+		traits::is_always_equal::value)
+	{
+		if (this == &other)
+			return *this;
+		if constexpr (!traits::propagate_on_container_move_assignment::value &&
+		              !traits::is_always_equal::value) {
+			/* memory of another resource cannot be taken over */
+			if (alloc_ != other.alloc_) {
+				assign_bits(other);
+				return *this;
+			}
+		}
+		release();
+		if constexpr (traits::propagate_on_container_move_assignment::value)
+			alloc_ = std::move(other.alloc_);
+		set_ = other.set_;
+		other.set_ = {};
+		return *this;
+	}
+
+	/* swaps the contents without allocating; the allocators must be
+	 | equal unless they propagate on swap */
+	void swap(basic_bitset &other) noexcept
+	{
+		using std::swap;
+		if constexpr (traits::propagate_on_container_swap::value)
+			swap(alloc_, other.alloc_);
+		swap(set_, other.set_);
+	}
+
+	friend void swap(basic_bitset &a, basic_bitset &b) noexcept { a.swap(b); }
+
+	allocator_type get_allocator() const noexcept { return alloc_; }
+
+	size_type size() const noexcept { return set_.size; }
+	size_type capacity() const noexcept { return set_.capacity; }
+	bool empty() const noexcept { return !set_.size; }
+
+	/* makes room for at least size bits without changing the size */
+	void reserve(size_type size)
+	{
+		if (size <= set_.capacity)
+			return;
+		size_type bytes = (size + 63) / 64 * 8;
+		unsigned char *data = traits::allocate(alloc_, bytes);
+		if (set_.data)
+			std::memcpy(data, set_.data, set_.capacity / 8);
+		std::memset(data + set_.capacity / 8, 0, bytes - set_.capacity / 8);
+		if (set_.data)
+			traits::deallocate(alloc_, set_.data, set_.capacity / 8);
+		set_.data = data;
+		set_.capacity = bytes * 8;
+	}
+
+	/* changes the size; new bits take the passed state and the capacity
+	 | at least doubles when it has to grow. A cached count and a rank
+	 | tree are adjusted, the tree only for the blocks that were added */
+	void resize(size_type size, bool state = false)
+	{
+		size_type old = set_.size;
+		unsigned int flags = set_.flags;
+		if (size > set_.capacity)
+			reserve(size < set_.capacity * 2 ? set_.capacity * 2 : size);
+		if ((flags & BITSET_COUNTED) && size < old)
+			set_.count -= bitset_rcount(&set_, size, old);
+
+		/* the tree still has the old size, it is rebuilt at the end */
+		set_.flags = 0;
+		set_.size = size;
+		if (size > old)
+			bitset_rclear(&set_, old, size);
+		set_.flags = flags & ~BITSET_RANKED;
+		if (size > old && state)
+			bitset_rset(&set_, old, size);
+		set_.flags = flags;
+		bitset_prefix_resize(&set_, old);
+	}
+
+	void push_back(bool state)
+	{
+		resize(set_.size + 1, state);
+	}
+
+	bool test(size_type index) const noexcept
+	{
+		return bitset_get(c_bitset(), index);
+	}
+
+	bool operator[](size_type index) const noexcept { return test(index); }
+
+	void set(size_type index, bool state = true) noexcept
+	{
+		bitset_set(&set_, index, state);
+	}
+
+	void reset(size_type index) noexcept { set(index, false); }
+
+	void set(size_type begin, size_type end) noexcept
+	{
+		bitset_rset(&set_, begin, end);
+	}
+
+	void reset(size_type begin, size_type end) noexcept
+	{
+		bitset_rclear(&set_, begin, end);
+	}
+
+	void clear() noexcept
+	{
+		if (set_.data)
+			bitset_clear(&set_);
+	}
+
+	size_type count() const noexcept { return bitset_count(c_bitset()); }
+
+	ones_view ones() const noexcept { return ones_view(c_bitset()); }
+	zeros_view zeros() const noexcept { return zeros_view(c_bitset()); }
+	runs_view runs() const noexcept { return runs_view(c_bitset()); }
+
+	struct bitset *c_bitset() noexcept { return &set_; }
+
+	/* the C functions take non-const pointers but only read here */
+	struct bitset *c_bitset() const noexcept
+	{
+		return const_cast<struct bitset *>(&set_);
+	}
+
+private:
+	void assign_bits(const basic_bitset &other)
+	{
+		set_.size = 0;
+		reserve(other.set_.size);
+		if (other.set_.size)
+			std::memcpy(set_.data, other.set_.data, (other.set_.size + 7) / 8);
+		set_.size = other.set_.size;
+		bitset_recount(&set_);
+	}
+
+	void release() noexcept
+	{
+		if (set_.ranks)
+			bitset_prefix_cache(&set_, 0);
+		if (set_.data)
+			traits::deallocate(alloc_, set_.data, set_.capacity / 8);
+	}
+
+	[[no_unique_address]] Allocator alloc_;
+	struct bitset set_ = {};
+};
+
+using dynamic_bitset = basic_bitset<>;
+
+namespace pmr {
+
+/* bitset whose data comes from a std::pmr::memory_resource, for example
+ | a monotonic buffer per request */
+using bitset = basic_bitset<std::pmr::polymorphic_allocator<unsigned char>>;
+
+} // namespace pmr
+
+static_assert(std::bidirectional_iterator<position_iterator<true>>);
+static_assert(std::bidirectional_iterator<run_iterator>);
+static_assert(std::ranges::bidirectional_range<ones_view>);
+static_assert(std::ranges::common_range<runs_view>);
+static_assert(std::ranges::view<zeros_view>);
+static_assert(std::is_nothrow_move_constructible_v<pmr::bitset>);
+static_assert(std::is_nothrow_move_assignable_v<dynamic_bitset>);
+
+} // namespace bitsets
+
+/* the iterators refer to the set, not to the view */
+template <bool Value>
+inline constexpr bool std::ranges::enable_borrowed_range<bitsets::position_view<Value>> = true;
+template <>
+inline constexpr bool std::ranges::enable_borrowed_range<bitsets::runs_view> = true;
+
+#endif /* BITSET_HPP */
@@ -0,0 +1,90 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset.h"
+#include "bitstream.h"
+#include "internal.c"
+
+/* bitset_writer_init(w, set)
+ |   starts appending to the end of a bitset; a partial last word is
+ |   taken into the accumulator, so that all stores are word-aligned
+ | w:   pointer to a [struct bitset_writer]
+ | set: valid pointer to a [struct bitset]
+ */
+void bitset_writer_init(struct bitset_writer *w, struct bitset *set)
+{
+	w->set = set;
+	w->index = set->size & ~(size_t)0x3f;
+	w->fill = set->size & 0x3f;
+	w->acc = w->fill ? bitset_word(set, set->size >> 6) : 0;
+	w->ones = 0 - (size_t)bitset_internal_popcount(w->acc);
+}
+
+/* bitset_writer_spill(w, value, n)
+ |   slow path of bitset_writer_put: stores the full accumulator as one
+ |   word and keeps the bits of value that did not fit
+ */
+int bitset_writer_spill(struct bitset_writer *w, uint64_t value,
+                        unsigned int n)
+{
+	struct bitset *set = w->set;
+	if (!bitset_reserve(set, w->index + 64))
+		return 0;
+
+	uint64_t word = w->acc | value << w->fill;
+	bitset_internal_store(set->data + (w->index >> 3), word, 8);
+	w->ones += bitset_internal_popcount(word);
+	w->index += 64;
+	w->acc = w->fill ? value >> (64 - w->fill) : 0;
+	w->fill = w->fill + n - 64;
+	return 1;
+}
+
+/* bitset_writer_flush(w)
+ |   stores the bits left in the accumulator and updates the size of
+ |   the bitset; the writer can be used further afterwards;
+ |   returns the size of the bitset, or 0 if memory could not be
+ |   allocated
+ | w: valid pointer to a [struct bitset_writer]
+ */
+size_t bitset_writer_flush(struct bitset_writer *w)
+{
+	struct bitset *set = w->set;
+	if (w->fill) {
+		if (!bitset_reserve(set, w->index + w->fill))
+			return 0;
+		bitset_internal_store(set->data + (w->index >> 3), w->acc,
+		                      bitset_internal_bytes(w->fill));
+	}
+	size_t old = set->size;
+	set->size = w->index + w->fill;
+	if (set->flags & BITSET_COUNTED)
+		set->count += w->ones + bitset_internal_popcount(w->acc);
+	/* the bits below old were stored again unchanged */
+	bitset_prefix_resize(set, old);
+	w->ones = 0 - (size_t)bitset_internal_popcount(w->acc);
+	return set->size;
+}
+
+/* bitset_reader_init(r, set, index)
+ |   starts reading a bitset at the specified bit
+ | r:     pointer to a [struct bitset_reader]
+ | set:   valid pointer to a [struct bitset]
+ | index: index of the first bit to read
+ */
+void bitset_reader_init(struct bitset_reader *r, struct bitset *set,
+                        size_t index)
+{
+	r->set = set;
+	r->next = (index >> 6) + 1;
+	r->cur = bitset_word(set, index >> 6) >> (index & 0x3f);
+	r->avail = 64 - (index & 0x3f);
+}
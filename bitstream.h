@@ -0,0 +1,132 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef BITSET_BITSTREAM_H
+#define BITSET_BITSTREAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitset.h"
+
+/* appends values to a growing bitset through a 64-bit accumulator that
+ | holds the fill bits starting at the word-aligned bit index; set->size
+ | and a cached count only cover the stream up to the last
+ | bitset_writer_flush, ones is the change of the count since then */
+struct bitset_writer {
+	struct bitset *set;
+	size_t index;
+	size_t ones;
+	uint64_t acc;
+	unsigned int fill;
+};
+
+/* reads values from a bitset one aligned word at a time; cur holds the
+ | avail lowest unread bits, next is the index of the following word */
+struct bitset_reader {
+	struct bitset *set;
+	uint64_t cur;
+	unsigned int avail;
+	size_t next;
+};
+
+void bitset_writer_init(struct bitset_writer *w, struct bitset *set);
+int bitset_writer_spill(struct bitset_writer *w, uint64_t value,
+                        unsigned int n);
+size_t bitset_writer_flush(struct bitset_writer *w);
+
+void bitset_reader_init(struct bitset_reader *r, struct bitset *set,
+                        size_t index);
+
+/* bitset_writer_put(w, value, n)
+ |   appends the n lowest bits of value, the lowest bit first; a whole
+ |   word is stored only when the accumulator is full;
+ |   returns 1 on success, 0 if memory could not be allocated
+ |   (the stream is left unchanged)
+ | w:     valid pointer to a [struct bitset_writer]
+ | value: bits to append
+ | n:     number of bits to append (1 to 64)
+ */
+static inline
+int bitset_writer_put(struct bitset_writer *w, uint64_t value, unsigned int n)
+{
+	if (n < 64)
+		value &= ~(~(uint64_t)0 << n);
+	if (w->fill + n < 64) {
+		w->acc |= value << w->fill;
+		w->fill += n;
+		return 1;
+	}
+	return bitset_writer_spill(w, value, n);
+}
+
+/* bitset_reader_peek(r, n)
+ |   returns the next n bits without consuming them, the first bit in
+ |   the lowest position; bits past the end of the bitset read as zero
+ | r: valid pointer to a [struct bitset_reader]
+ | n: number of bits to look at (1 to 64)
+ */
+static inline
+uint64_t bitset_reader_peek(struct bitset_reader *r, unsigned int n)
+{
+	uint64_t x = r->cur;
+	if (r->avail < n)
+		x |= bitset_word(r->set, r->next) << r->avail;
+	return n < 64 ? x & ~(~(uint64_t)0 << n) : x;
+}
+
+/* bitset_reader_consume(r, n)
+ |   skips the next n bits, loading the following word once the
+ |   current one is used up
+ | r: valid pointer to a [struct bitset_reader]
+ | n: number of bits to skip (0 to 64)
+ */
+static inline
+void bitset_reader_consume(struct bitset_reader *r, unsigned int n)
+{
+	if (n < r->avail) {
+		r->cur >>= n;
+		r->avail -= n;
+		return;
+	}
+	n -= r->avail;
+	uint64_t word = bitset_word(r->set, r->next++);
+	r->cur = n < 64 ? word >> n : 0;
+	r->avail = 64 - n;
+}
+
+/* bitset_reader_get(r, n)
+ |   returns and consumes the next n bits
+ | r: valid pointer to a [struct bitset_reader]
+ | n: number of bits to read (1 to 64)
+ */
+static inline
+uint64_t bitset_reader_get(struct bitset_reader *r, unsigned int n)
+{
+	uint64_t x = bitset_reader_peek(r, n);
+	bitset_reader_consume(r, n);
+	return x;
+}
+
+/* bitset_reader_tell(r)
+ |   returns the index of the next bit to be read
+ | r: valid pointer to a [struct bitset_reader]
+ */
+static inline
+size_t bitset_reader_tell(struct bitset_reader *r)
+{
+	return (r->next << 6) - r->avail;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BITSET_BITSTREAM_H */
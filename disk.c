@@ -0,0 +1,534 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "bitset.h"
+#include "disk.h"
+#include "internal.c"
+
+#define BITSET_DISK_WORDS (BITSET_DISK_BLOCK / 8)
+
+static const char bitset_disk_magic[8] = "bitdisk";
+
+static inline
+uint64_t bitset_disk_word(const unsigned char *block, size_t w)
+{
+	return bitset_internal_load(block + (w << 3), 8);
+}
+
+static inline
+off_t bitset_disk_offset(size_t block)
+{
+	return (off_t)(block + 1) * BITSET_DISK_BLOCK;
+}
+
+static
+int bitset_disk_pread(int fd, void *buf, size_t len, off_t offset)
+{
+	for (size_t done = 0; done < len; ) {
+		ssize_t n = pread(fd, (char *)buf + done, len - done, offset + done);
+		if (n <= 0)
+			return 0;
+		done += n;
+	}
+	return 1;
+}
+
+static
+int bitset_disk_pwrite(int fd, const void *buf, size_t len, off_t offset)
+{
+	for (size_t done = 0; done < len; ) {
+		ssize_t n = pwrite(fd, (const char *)buf + done, len - done,
+		                   offset + done);
+		if (n <= 0)
+			return 0;
+		done += n;
+	}
+	return 1;
+}
+
+/* sets up the pool for an open file whose size is already known */
+static
+struct bitset_disk *bitset_disk_init(int fd, size_t size, size_t frames)
+{
+	struct bitset_disk *disk = calloc(1, sizeof(struct bitset_disk));
+	if (!disk)
+		return NULL;
+	disk->fd = fd;
+	disk->size = size;
+	disk->blocks = (size >> BITSET_DISK_SHIFT) +
+	               !!(size & ((1 << BITSET_DISK_SHIFT) - 1));
+	disk->num = frames ? frames : 1;
+	disk->last = SIZE_MAX;
+	disk->window = disk->num / 8 < 32 ? disk->num / 8 : 32;
+	disk->table = malloc((disk->blocks ? disk->blocks : 1) * sizeof(size_t));
+	disk->frames = calloc(disk->num, sizeof(struct bitset_disk_frame));
+	if (!disk->table || !disk->frames ||
+	    posix_memalign((void **)&disk->memory, BITSET_DISK_BLOCK,
+	                   disk->num * BITSET_DISK_BLOCK)) {
+		free(disk->table);
+		free(disk->frames);
+		free(disk);
+		return NULL;
+	}
+	for (size_t i = 0; i < disk->blocks; ++i)
+		disk->table[i] = SIZE_MAX;
+	for (size_t f = 0; f < disk->num; ++f) {
+		disk->frames[f].block = SIZE_MAX;
+		disk->frames[f].data = disk->memory + f * BITSET_DISK_BLOCK;
+	}
+	pthread_mutex_init(&disk->lock, NULL);
+	pthread_cond_init(&disk->cond, NULL);
+	return disk;
+}
+
+/* bitset_disk_create(path, size, frames)
+ |   creates a file for a cleared bitset; the data blocks are left as a
+ |   hole, so no space is used for blocks that are never written;
+ |   returns a pointer to the allocated struct, or NULL on failure
+ | path:   name of the file, which is created or replaced
+ | size:   number of bits
+ | frames: number of blocks the buffer pool holds in memory
+ */
+struct bitset_disk *bitset_disk_create(const char *path, size_t size,
+                                       size_t frames)
+{
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return NULL;
+
+	unsigned char header[BITSET_DISK_BLOCK] = {0};
+	uint64_t bits = bitset_internal_le64((uint64_t)size);
+	memcpy(header, bitset_disk_magic, 8);
+	memcpy(header + 8, &bits, 8);
+	struct bitset_disk *disk = NULL;
+	if (bitset_disk_pwrite(fd, header, BITSET_DISK_BLOCK, 0))
+		disk = bitset_disk_init(fd, size, frames);
+	if (!disk || ftruncate(fd, bitset_disk_offset(disk->blocks))) {
+		if (disk)
+			bitset_disk_close(disk);
+		else
+			close(fd);
+		return NULL;
+	}
+	return disk;
+}
+
+/* bitset_disk_open(path, frames)
+ |   opens a file written through bitset_disk_create;
+ |   returns a pointer to the allocated struct, or NULL on failure
+ | path:   name of the file
+ | frames: number of blocks the buffer pool holds in memory
+ */
+struct bitset_disk *bitset_disk_open(const char *path, size_t frames)
+{
+	int fd = open(path, O_RDWR);
+	if (fd < 0)
+		return NULL;
+
+	unsigned char header[16];
+	uint64_t bits;
+	struct stat st;
+	struct bitset_disk *disk = NULL;
+	if (bitset_disk_pread(fd, header, 16, 0) &&
+	    !memcmp(header, bitset_disk_magic, 8)) {
+		memcpy(&bits, header + 8, 8);
+		disk = bitset_disk_init(fd, bitset_internal_le64(bits), frames);
+	}
+	if (!disk || fstat(fd, &st) ||
+	    st.st_size < bitset_disk_offset(disk->blocks)) {
+		if (disk)
+			bitset_disk_close(disk);
+		else
+			close(fd);
+		return NULL;
+	}
+	return disk;
+}
+
+/* writes back every dirty frame that is not busy; lock must be held */
+static
+int bitset_disk_writeback(struct bitset_disk *disk)
+{
+	int ok = 1;
+	for (size_t f = 0; f < disk->num; ++f) {
+		struct bitset_disk_frame *frame = disk->frames + f;
+		if (!frame->dirty || frame->busy)
+			continue;
+		if (bitset_disk_pwrite(disk->fd, frame->data, BITSET_DISK_BLOCK,
+		                       bitset_disk_offset(frame->block)))
+			frame->dirty = 0;
+		else
+			ok = 0;
+	}
+	return ok;
+}
+
+/* bitset_disk_flush(disk)
+ |   writes all modified blocks back to the file and waits until they
+ |   are stable; blocks stay in the pool;
+ |   returns 1 on success, 0 on failure
+ | disk: valid pointer to a [struct bitset_disk]
+ */
+int bitset_disk_flush(struct bitset_disk *disk)
+{
+	pthread_mutex_lock(&disk->lock);
+	int ok = bitset_disk_writeback(disk);
+	pthread_mutex_unlock(&disk->lock);
+	return !fdatasync(disk->fd) && ok;
+}
+
+/* bitset_disk_close(disk)
+ |   flushes the bitset and frees memory associated with it; no block
+ |   may be pinned anymore;
+ |   returns 1 on success, 0 if modifications could not be written
+ | disk: pointer to a [struct bitset_disk]
+ */
+int bitset_disk_close(struct bitset_disk *disk)
+{
+	if (!disk)
+		return 1;
+	int ok = bitset_disk_flush(disk);
+	if (close(disk->fd))
+		ok = 0;
+	pthread_mutex_destroy(&disk->lock);
+	pthread_cond_destroy(&disk->cond);
+	free(disk->memory);
+	free(disk->frames);
+	free(disk->table);
+	free(disk);
+	return ok;
+}
+
+/* CLOCK: takes the first frame that is empty or has not been referenced
+ | since the hand last passed; dirty victims are written back while the
+ | lock is held, so no one can read the old contents from the file in
+ | between. Returns SIZE_MAX if every frame is pinned or busy */
+static
+size_t bitset_disk_victim(struct bitset_disk *disk)
+{
+	for (size_t step = 0; step < 2 * disk->num; ++step) {
+		size_t f = disk->hand;
+		struct bitset_disk_frame *frame = disk->frames + f;
+		disk->hand = disk->hand + 1 < disk->num ? disk->hand + 1 : 0;
+		if (frame->pins || frame->busy)
+			continue;
+		if (frame->block != SIZE_MAX && frame->referenced) {
+			frame->referenced = 0;
+			continue;
+		}
+		if (frame->block != SIZE_MAX) {
+			if (frame->dirty &&
+			    !bitset_disk_pwrite(disk->fd, frame->data, BITSET_DISK_BLOCK,
+			                        bitset_disk_offset(frame->block)))
+				continue;
+			disk->table[frame->block] = SIZE_MAX;
+		}
+		frame->block = SIZE_MAX;
+		frame->dirty = 0;
+		return f;
+	}
+	return SIZE_MAX;
+}
+
+/* bitset_disk_pin(disk, block)
+ |   makes a block resident and keeps it from being evicted until it is
+ |   unpinned. On a miss during a scan, blocks ahead in the direction of
+ |   the scan are read with the same request, but left unpinned and
+ |   first in line for eviction. Threads that share a block must agree
+ |   on how they modify it;
+ |   returns a pointer to the BITSET_DISK_BLOCK bytes of the block, or
+ |   NULL if all frames are pinned or the block could not be read
+ | disk:  valid pointer to a [struct bitset_disk]
+ | block: index of the block, covering bits from block << BITSET_DISK_SHIFT
+ */
+unsigned char *bitset_disk_pin(struct bitset_disk *disk, size_t block)
+{
+	pthread_mutex_lock(&disk->lock);
+	int direction = block == disk->last + 1 ? 1
+	              : block + 1 == disk->last ? -1 : 0;
+	if (direction || block != disk->last)
+		disk->direction = direction;
+	disk->last = block;
+
+	size_t f;
+	while ((f = disk->table[block]) != SIZE_MAX && disk->frames[f].busy)
+		pthread_cond_wait(&disk->cond, &disk->lock);
+	if (f != SIZE_MAX) {
+		disk->frames[f].pins++;
+		disk->frames[f].referenced = 1;
+		pthread_mutex_unlock(&disk->lock);
+		return disk->frames[f].data;
+	}
+
+	size_t batch[32];
+	size_t num = 0, first = block;
+	if ((f = bitset_disk_victim(disk)) == SIZE_MAX) {
+		pthread_mutex_unlock(&disk->lock);
+		return NULL;
+	}
+	disk->frames[f].pins = 1;
+
+	/* read ahead while the blocks are missing, within the file and at
+	 | most a quarter of the pool */
+	unsigned int window = disk->window < disk->num / 4 ? disk->window
+	                                                   : disk->num / 4;
+	for (size_t next = block; f != SIZE_MAX; f = bitset_disk_victim(disk)) {
+		disk->frames[f].block = next;
+		disk->frames[f].busy = 1;
+		disk->frames[f].referenced = !num;
+		disk->table[next] = f;
+		batch[num++] = f;
+		first = next < first ? next : first;
+
+		next = disk->direction > 0 ? next + 1 : next - 1;
+		if (!disk->direction || num >= window || num >= 32 ||
+		    next >= disk->blocks || disk->table[next] != SIZE_MAX)
+			break;
+	}
+
+	/* frames in file order */
+	struct iovec iov[32];
+	for (size_t i = 0; i < num; ++i) {
+		size_t b = disk->frames[batch[i]].block;
+		iov[b - first].iov_base = disk->frames[batch[i]].data;
+		iov[b - first].iov_len = BITSET_DISK_BLOCK;
+	}
+	pthread_mutex_unlock(&disk->lock);
+
+	int ok = preadv(disk->fd, iov, num, bitset_disk_offset(first)) ==
+	         (ssize_t)(num * BITSET_DISK_BLOCK);
+	for (size_t i = 0; !ok && i < num; ++i) {
+		/* short read, retry block by block */
+		if (!bitset_disk_pread(disk->fd, iov[i].iov_base, BITSET_DISK_BLOCK,
+		                       bitset_disk_offset(first + i)))
+			break;
+		ok = i + 1 == num;
+	}
+
+	pthread_mutex_lock(&disk->lock);
+	for (size_t i = 0; i < num; ++i) {
+		struct bitset_disk_frame *frame = disk->frames + batch[i];
+		frame->busy = 0;
+		if (!ok) {
+			disk->table[frame->block] = SIZE_MAX;
+			frame->block = SIZE_MAX;
+			frame->pins = 0;
+		}
+	}
+	pthread_cond_broadcast(&disk->cond);
+	pthread_mutex_unlock(&disk->lock);
+	return ok ? disk->frames[batch[0]].data : NULL;
+}
+
+/* bitset_disk_unpin(disk, block, dirty)
+ |   releases a block pinned by bitset_disk_pin
+ | disk:  valid pointer to a [struct bitset_disk]
+ | block: index of a pinned block
+ | dirty: nonzero if the block was modified and has to be written back
+ */
+void bitset_disk_unpin(struct bitset_disk *disk, size_t block,
+                       unsigned int dirty)
+{
+	pthread_mutex_lock(&disk->lock);
+	struct bitset_disk_frame *frame = disk->frames + disk->table[block];
+	frame->pins--;
+	frame->dirty |= !!dirty;
+	pthread_mutex_unlock(&disk->lock);
+}
+
+/* bitset_disk_get(disk, index)
+ |   returns the state of a bit, or 0 if its block could not be read
+ | disk:  valid pointer to a [struct bitset_disk]
+ | index: position of the bit, smaller than the size
+ */
+unsigned int bitset_disk_get(struct bitset_disk *disk, size_t index)
+{
+	size_t block = index >> BITSET_DISK_SHIFT;
+	const unsigned char *data = bitset_disk_pin(disk, block);
+	if (!data)
+		return 0;
+	unsigned int state =
+		data[(index >> 3) & (BITSET_DISK_BLOCK - 1)] >> (index & 0x7) & 1;
+	bitset_disk_unpin(disk, block, 0);
+	return state;
+}
+
+/* bitset_disk_set(disk, index, state)
+ |   sets or clears a bit; the block is written back when it is evicted
+ |   or flushed;
+ |   returns 1 on success, 0 if the block could not be read
+ | disk:  valid pointer to a [struct bitset_disk]
+ | index: position of the bit, smaller than the size
+ | state: nonzero to set the bit, zero to clear it
+ */
+int bitset_disk_set(struct bitset_disk *disk, size_t index,
+                    unsigned int state)
+{
+	size_t block = index >> BITSET_DISK_SHIFT;
+	unsigned char *data = bitset_disk_pin(disk, block);
+	if (!data)
+		return 0;
+	unsigned char *byte = data + ((index >> 3) & (BITSET_DISK_BLOCK - 1));
+	unsigned char bit = 1 << (index & 0x7);
+	unsigned char old = *byte;
+	*byte = state ? old | bit : old & ~bit;
+	bitset_disk_unpin(disk, block, *byte != old);
+	return 1;
+}
+
+/* bitset_disk_count(disk)
+ |   returns the number of set bits, reading the blocks in order, or
+ |   SIZE_MAX if a block could not be read
+ | disk: valid pointer to a [struct bitset_disk]
+ */
+size_t bitset_disk_count(struct bitset_disk *disk)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < disk->blocks; ++i) {
+		const unsigned char *data = bitset_disk_pin(disk, i);
+		if (!data)
+			return SIZE_MAX;
+		for (size_t w = 0; w < BITSET_DISK_WORDS; ++w)
+			count += bitset_internal_popcount(bitset_disk_word(data, w));
+		bitset_disk_unpin(disk, i, 0);
+	}
+	return count;
+}
+
+/* bitset_disk_next(disk, index)
+ |   returns the index of the first set bit at or after index, or
+ |   SIZE_MAX if there is none or a block could not be read
+ | disk:  valid pointer to a [struct bitset_disk]
+ | index: position to start searching from
+ */
+size_t bitset_disk_next(struct bitset_disk *disk, size_t index)
+{
+	if (index >= disk->size)
+		return SIZE_MAX;
+
+	size_t i = index >> BITSET_DISK_SHIFT;
+	size_t w = (index >> 6) & (BITSET_DISK_WORDS - 1);
+	uint64_t mask = ~(uint64_t)0 << (index & 0x3f);
+	for (; i < disk->blocks; ++i, w = 0, mask = ~(uint64_t)0) {
+		const unsigned char *data = bitset_disk_pin(disk, i);
+		if (!data)
+			return SIZE_MAX;
+		for (; w < BITSET_DISK_WORDS; ++w, mask = ~(uint64_t)0) {
+			uint64_t word = bitset_disk_word(data, w) & mask;
+			if (word) {
+				bitset_disk_unpin(disk, i, 0);
+				size_t bit = ((i << BITSET_DISK_SHIFT) | (w << 6)) +
+				             bitset_internal_ctz(word);
+				return bit < disk->size ? bit : SIZE_MAX;
+			}
+		}
+		bitset_disk_unpin(disk, i, 0);
+	}
+	return SIZE_MAX;
+}
+
+/* bitset_disk_prev(disk, index)
+ |   returns the index of the last set bit at or before index, or
+ |   SIZE_MAX if there is none or a block could not be read; the blocks
+ |   are read ahead backwards
+ | disk:  valid pointer to a [struct bitset_disk]
+ | index: position to start searching from, clamped to the size
+ */
+size_t bitset_disk_prev(struct bitset_disk *disk, size_t index)
+{
+	if (!disk->size)
+		return SIZE_MAX;
+	if (index >= disk->size)
+		index = disk->size - 1;
+
+	size_t i = index >> BITSET_DISK_SHIFT;
+	size_t w = (index >> 6) & (BITSET_DISK_WORDS - 1);
+	uint64_t mask = ~(uint64_t)0 >> (63 - (index & 0x3f));
+	for (size_t blocks = i + 1; blocks--; --i,
+	     w = BITSET_DISK_WORDS - 1, mask = ~(uint64_t)0) {
+		const unsigned char *data = bitset_disk_pin(disk, i);
+		if (!data)
+			return SIZE_MAX;
+		for (size_t words = w + 1; words--; --w, mask = ~(uint64_t)0) {
+			uint64_t word = bitset_disk_word(data, w) & mask;
+			if (word) {
+				bitset_disk_unpin(disk, i, 0);
+				return ((i << BITSET_DISK_SHIFT) | (w << 6)) + 63 -
+				       bitset_internal_clz(word);
+			}
+		}
+		bitset_disk_unpin(disk, i, 0);
+	}
+	return SIZE_MAX;
+}
+
+/* combines src into dst block by block; with and set, dst &= src,
+ | otherwise dst |= src */
+static
+int bitset_disk_combine(struct bitset_disk *dst, struct bitset_disk *src,
+                        int and)
+{
+	if (dst->size != src->size)
+		return 0;
+	for (size_t i = 0; i < dst->blocks; ++i) {
+		unsigned char *to = bitset_disk_pin(dst, i);
+		const unsigned char *from = to ? bitset_disk_pin(src, i) : NULL;
+		if (!from) {
+			if (to)
+				bitset_disk_unpin(dst, i, 0);
+			return 0;
+		}
+		uint64_t changed = 0;
+		for (size_t w = 0; w < BITSET_DISK_WORDS; ++w) {
+			uint64_t a = bitset_disk_word(to, w);
+			uint64_t b = bitset_disk_word(from, w);
+			uint64_t word = and ? a & b : a | b;
+			changed |= word ^ a;
+			bitset_internal_store(to + (w << 3), word, 8);
+		}
+		bitset_disk_unpin(src, i, 0);
+		bitset_disk_unpin(dst, i, !!changed);
+	}
+	return 1;
+}
+
+/* bitset_disk_or(dst, src)
+ |   sets every bit of dst that is set in src, one pair of blocks at a
+ |   time; returns 1 on success, 0 on failure (the blocks done so far
+ |   are kept)
+ | dst: valid pointer to a [struct bitset_disk]
+ | src: valid pointer to a [struct bitset_disk] of the same size, but
+ |      not the same struct
+ */
+int bitset_disk_or(struct bitset_disk *dst, struct bitset_disk *src)
+{
+	return bitset_disk_combine(dst, src, 0);
+}
+
+/* bitset_disk_and(dst, src)
+ |   clears every bit of dst that is clear in src, one pair of blocks at
+ |   a time; returns 1 on success, 0 on failure (the blocks done so far
+ |   are kept)
+ | dst: valid pointer to a [struct bitset_disk]
+ | src: valid pointer to a [struct bitset_disk] of the same size, but
+ |      not the same struct
+ */
+int bitset_disk_and(struct bitset_disk *dst, struct bitset_disk *src)
+{
+	return bitset_disk_combine(dst, src, 1);
+}
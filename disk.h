@@ -0,0 +1,79 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef BITSET_DISK_H
+#define BITSET_DISK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitset.h"
+
+/* bytes per block and the number of bits a block holds as a shift; the
+ | file holds a header block followed by the data blocks */
+#define BITSET_DISK_BLOCK 4096
+#define BITSET_DISK_SHIFT 15
+
+/* slot of the buffer pool; a frame is busy while its block is read,
+ | and only frames that are neither pinned nor busy are evicted */
+struct bitset_disk_frame {
+	size_t block;
+	unsigned int pins;
+	unsigned int referenced;
+	unsigned int dirty;
+	unsigned int busy;
+	unsigned char *data;
+};
+
+/* bitset in a file, accessed block-at-a-time through a CLOCK buffer
+ | pool of num frames. table maps blocks to frames or SIZE_MAX; last
+ | and direction follow the scan to read ahead up to window blocks
+ | when a block is missed. lock guards everything but the file */
+struct bitset_disk {
+	int fd;
+	size_t size;
+	size_t blocks;
+	size_t num;
+	size_t hand;
+	size_t last;
+	int direction;
+	unsigned int window;
+	size_t *table;
+	struct bitset_disk_frame *frames;
+	unsigned char *memory;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+struct bitset_disk *bitset_disk_create(const char *path, size_t size,
+                                       size_t frames);
+struct bitset_disk *bitset_disk_open(const char *path, size_t frames);
+int bitset_disk_close(struct bitset_disk *disk);
+int bitset_disk_flush(struct bitset_disk *disk);
+
+unsigned char *bitset_disk_pin(struct bitset_disk *disk, size_t block);
+void bitset_disk_unpin(struct bitset_disk *disk, size_t block,
+                       unsigned int dirty);
+
+unsigned int bitset_disk_get(struct bitset_disk *disk, size_t index);
+int bitset_disk_set(struct bitset_disk *disk, size_t index,
+                    unsigned int state);
+size_t bitset_disk_count(struct bitset_disk *disk);
+size_t bitset_disk_next(struct bitset_disk *disk, size_t index);
+size_t bitset_disk_prev(struct bitset_disk *disk, size_t index);
+int bitset_disk_or(struct bitset_disk *dst, struct bitset_disk *src);
+int bitset_disk_and(struct bitset_disk *dst, struct bitset_disk *src);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BITSET_DISK_H */
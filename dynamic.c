@@ -0,0 +1,721 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset.h"
+#include "dynamic.h"
+#include "internal.c"
+
+#define BITSET_DYNAMIC_WORDS (BITSET_DYNAMIC_LEAF / 64)
+
+struct bitset_dynamic_leaf {
+	uint64_t bits[BITSET_DYNAMIC_WORDS];
+};
+
+/* a child together with the number of bits and set bits below it */
+struct bitset_dynamic_entry {
+	void *child;
+	size_t size;
+	size_t ones;
+};
+
+static inline
+uint64_t bitset_dynamic_mask(size_t len)
+{
+	return len < 64 ? ~(~(uint64_t)0 << len) : ~(uint64_t)0;
+}
+
+/* reads len (at most 64) bits of a leaf starting at off */
+static inline
+uint64_t bitset_dynamic_bits(const uint64_t *bits, size_t off, size_t len)
+{
+	size_t w = off >> 6;
+	unsigned int s = off & 0x3f;
+	uint64_t x = bits[w] >> s;
+	if (s && s + len > 64)
+		x |= bits[w + 1] << (64 - s);
+	return x & bitset_dynamic_mask(len);
+}
+
+/* writes len (at most 64) bits into a leaf starting at off */
+static inline
+void bitset_dynamic_put(uint64_t *bits, size_t off, uint64_t x, size_t len)
+{
+	size_t w = off >> 6;
+	unsigned int s = off & 0x3f;
+	uint64_t mask = bitset_dynamic_mask(len);
+	x &= mask;
+	bits[w] = (bits[w] & ~(mask << s)) | (x << s);
+	if (s && s + len > 64)
+		bits[w + 1] = (bits[w + 1] & ~(mask >> (64 - s))) | (x >> (64 - s));
+}
+
+/* copies num bits between two distinct leaves */
+static
+void bitset_dynamic_copy(uint64_t *dst, size_t dst_off,
+                         const uint64_t *src, size_t src_off, size_t num)
+{
+	while (num) {
+		size_t len = num < 64 ? num : 64;
+		bitset_dynamic_put(dst, dst_off,
+		                   bitset_dynamic_bits(src, src_off, len), len);
+		dst_off += len;
+		src_off += len;
+		num -= len;
+	}
+}
+
+static
+size_t bitset_dynamic_popcount(const uint64_t *bits)
+{
+	size_t ones = 0;
+	for (size_t i = 0; i < BITSET_DYNAMIC_WORDS; ++i)
+		ones += bitset_internal_popcount(bits[i]);
+	return ones;
+}
+
+/* shifts the bits at and above index up by one and stores state at
+ | index; the leaf must not be full */
+static
+void bitset_dynamic_leaf_insert(uint64_t *bits, size_t size, size_t index,
+                                unsigned int state)
+{
+	size_t first = index >> 6;
+	uint64_t low = bitset_dynamic_mask(index & 0x3f);
+	for (size_t w = size >> 6; w > first; --w)
+		bits[w] = (bits[w] << 1) | (bits[w - 1] >> 63);
+	bits[first] = (bits[first] & low) | ((bits[first] & ~low) << 1)
+	            | ((uint64_t)!!state << (index & 0x3f));
+}
+
+/* removes the bit at index, shifting the bits above it down by one;
+ | returns the state of the removed bit */
+static
+unsigned int bitset_dynamic_leaf_erase(uint64_t *bits, size_t size,
+                                       size_t index)
+{
+	size_t first = index >> 6;
+	size_t last = (size - 1) >> 6;
+	uint64_t low = bitset_dynamic_mask(index & 0x3f);
+	unsigned int state = bits[first] >> (index & 0x3f) & 1;
+	bits[first] = (bits[first] & low) | ((bits[first] >> 1) & ~low);
+	for (size_t w = first; w < last; ++w) {
+		bits[w] |= bits[w + 1] << 63;
+		bits[w + 1] >>= 1;
+	}
+	return state;
+}
+
+static
+void bitset_dynamic_node_free(struct bitset_dynamic_node *node)
+{
+	for (unsigned int c = 0; c < node->num; ++c) {
+		if (node->leaves)
+			free(node->child[c]);
+		else
+			bitset_dynamic_node_free(node->child[c]);
+	}
+	free(node);
+}
+
+static
+struct bitset_dynamic_entry bitset_dynamic_totals(struct bitset_dynamic_node *node)
+{
+	struct bitset_dynamic_entry e = { node, 0, 0 };
+	for (unsigned int c = 0; c < node->num; ++c) {
+		e.size += node->sizes[c];
+		e.ones += node->ones[c];
+	}
+	return e;
+}
+
+static
+struct bitset_dynamic_node *bitset_dynamic_take(struct bitset_dynamic *dyn,
+                                                unsigned int leaves)
+{
+	struct bitset_dynamic_node *node = dyn->spare;
+	dyn->spare = node->child[0];
+	--dyn->spares;
+	memset(node, 0, sizeof(struct bitset_dynamic_node));
+	node->leaves = leaves;
+	return node;
+}
+
+static
+void *bitset_dynamic_take_leaf(struct bitset_dynamic *dyn)
+{
+	void *leaf = dyn->spare_leaf;
+	dyn->spare_leaf = NULL;
+	memset(leaf, 0, sizeof(struct bitset_dynamic_leaf));
+	return leaf;
+}
+
+/* makes sure that the splits of one insertion can be served */
+static
+int bitset_dynamic_reserve(struct bitset_dynamic *dyn)
+{
+	if (!dyn->spare_leaf) {
+		dyn->spare_leaf = malloc(sizeof(struct bitset_dynamic_leaf));
+		if (!dyn->spare_leaf)
+			return 0;
+	}
+	while (dyn->spares < dyn->height + 1) {
+		struct bitset_dynamic_node *node =
+			malloc(sizeof(struct bitset_dynamic_node));
+		if (!node)
+			return 0;
+		node->child[0] = dyn->spare;
+		dyn->spare = node;
+		++dyn->spares;
+	}
+	return 1;
+}
+
+static
+void bitset_dynamic_put_entry(struct bitset_dynamic_node *node, unsigned int pos,
+                              struct bitset_dynamic_entry e)
+{
+	unsigned int n = node->num - pos;
+	memmove(node->sizes + pos + 1, node->sizes + pos, n * sizeof(size_t));
+	memmove(node->ones + pos + 1, node->ones + pos, n * sizeof(size_t));
+	memmove(node->child + pos + 1, node->child + pos, n * sizeof(void *));
+	node->sizes[pos] = e.size;
+	node->ones[pos] = e.ones;
+	node->child[pos] = e.child;
+	++node->num;
+}
+
+static
+void bitset_dynamic_drop_entry(struct bitset_dynamic_node *node, unsigned int pos)
+{
+	unsigned int n = node->num - pos - 1;
+	memmove(node->sizes + pos, node->sizes + pos + 1, n * sizeof(size_t));
+	memmove(node->ones + pos, node->ones + pos + 1, n * sizeof(size_t));
+	memmove(node->child + pos, node->child + pos + 1, n * sizeof(void *));
+	--node->num;
+}
+
+/* moves count entries of src starting at pos to the end of dst */
+static
+void bitset_dynamic_move(struct bitset_dynamic_node *dst,
+                         struct bitset_dynamic_node *src,
+                         unsigned int pos, unsigned int count)
+{
+	memcpy(dst->sizes + dst->num, src->sizes + pos, count * sizeof(size_t));
+	memcpy(dst->ones + dst->num, src->ones + pos, count * sizeof(size_t));
+	memcpy(dst->child + dst->num, src->child + pos, count * sizeof(void *));
+	dst->num += count;
+	src->num -= count;
+	unsigned int n = src->num - pos;
+	memmove(src->sizes + pos, src->sizes + pos + count, n * sizeof(size_t));
+	memmove(src->ones + pos, src->ones + pos + count, n * sizeof(size_t));
+	memmove(src->child + pos, src->child + pos + count, n * sizeof(void *));
+}
+
+/* adds an entry at pos, splitting a full node;
+ | returns the new right half or NULL if no split was necessary */
+static
+struct bitset_dynamic_node *bitset_dynamic_add(struct bitset_dynamic *dyn,
+                                               struct bitset_dynamic_node *node,
+                                               unsigned int pos,
+                                               struct bitset_dynamic_entry e)
+{
+	const unsigned int half = BITSET_DYNAMIC_FANOUT / 2;
+	if (node->num < BITSET_DYNAMIC_FANOUT) {
+		bitset_dynamic_put_entry(node, pos, e);
+		return NULL;
+	}
+
+	struct bitset_dynamic_node *right = bitset_dynamic_take(dyn, node->leaves);
+	bitset_dynamic_move(right, node, half, node->num - half);
+	if (pos <= half)
+		bitset_dynamic_put_entry(node, pos, e);
+	else
+		bitset_dynamic_put_entry(right, pos - half, e);
+	return right;
+}
+
+static
+struct bitset_dynamic_node *bitset_dynamic_insert_at(struct bitset_dynamic *dyn,
+                                                     struct bitset_dynamic_node *node,
+                                                     size_t index,
+                                                     unsigned int state)
+{
+	struct bitset_dynamic_entry e = { NULL, 0, 0 };
+	unsigned int c = 0;
+	while (c + 1 < node->num && index > node->sizes[c])
+		index -= node->sizes[c++];
+
+	if (node->leaves) {
+		struct bitset_dynamic_leaf *leaf = node->child[c];
+		if (node->sizes[c] == BITSET_DYNAMIC_LEAF) {
+			const size_t half = BITSET_DYNAMIC_LEAF / 2;
+			struct bitset_dynamic_leaf *right = bitset_dynamic_take_leaf(dyn);
+			memcpy(right->bits, leaf->bits + BITSET_DYNAMIC_WORDS / 2,
+			       BITSET_DYNAMIC_WORDS / 2 * sizeof(uint64_t));
+			memset(leaf->bits + BITSET_DYNAMIC_WORDS / 2, 0,
+			       BITSET_DYNAMIC_WORDS / 2 * sizeof(uint64_t));
+			e.child = right;
+			e.size = half;
+			e.ones = bitset_dynamic_popcount(right->bits);
+			node->sizes[c] = half;
+			node->ones[c] -= e.ones;
+			if (index > half) {
+				bitset_dynamic_leaf_insert(right->bits, half, index - half, state);
+				++e.size;
+				e.ones += !!state;
+				return bitset_dynamic_add(dyn, node, c + 1, e);
+			}
+		}
+		bitset_dynamic_leaf_insert(leaf->bits, node->sizes[c], index, state);
+	} else {
+		struct bitset_dynamic_node *right =
+			bitset_dynamic_insert_at(dyn, node->child[c], index, state);
+		if (right) {
+			e = bitset_dynamic_totals(right);
+			node->sizes[c] -= e.size;
+			node->ones[c] -= e.ones;
+		}
+	}
+
+	++node->sizes[c];
+	node->ones[c] += !!state;
+	return e.child ? bitset_dynamic_add(dyn, node, c + 1, e) : NULL;
+}
+
+/* rebalances child c after it may have become underfull */
+static
+void bitset_dynamic_fix(struct bitset_dynamic_node *node, unsigned int c)
+{
+	if (node->num < 2)
+		return;
+
+	unsigned int l = c + 1 < node->num ? c : c - 1;
+	unsigned int r = l + 1;
+
+	if (node->leaves) {
+		if (node->sizes[c] >= BITSET_DYNAMIC_LEAF / 4)
+			return;
+		struct bitset_dynamic_leaf *left = node->child[l];
+		struct bitset_dynamic_leaf *right = node->child[r];
+		size_t total = node->sizes[l] + node->sizes[r];
+
+		if (total <= BITSET_DYNAMIC_LEAF * 3 / 4) {
+			bitset_dynamic_copy(left->bits, node->sizes[l],
+			                    right->bits, 0, node->sizes[r]);
+			node->sizes[l] = total;
+			node->ones[l] += node->ones[r];
+			free(right);
+			bitset_dynamic_drop_entry(node, r);
+			return;
+		}
+
+		uint64_t tmp[2 * BITSET_DYNAMIC_WORDS] = { 0 };
+		size_t half = total / 2;
+		bitset_dynamic_copy(tmp, 0, left->bits, 0, node->sizes[l]);
+		bitset_dynamic_copy(tmp, node->sizes[l], right->bits, 0, node->sizes[r]);
+		memset(left, 0, sizeof(struct bitset_dynamic_leaf));
+		memset(right, 0, sizeof(struct bitset_dynamic_leaf));
+		bitset_dynamic_copy(left->bits, 0, tmp, 0, half);
+		bitset_dynamic_copy(right->bits, 0, tmp, half, total - half);
+		node->sizes[l] = half;
+		node->sizes[r] = total - half;
+		node->ones[l] = bitset_dynamic_popcount(left->bits);
+		node->ones[r] = bitset_dynamic_popcount(right->bits);
+		return;
+	}
+
+	struct bitset_dynamic_node *child = node->child[c];
+	if (child->num >= BITSET_DYNAMIC_FANOUT / 4)
+		return;
+	struct bitset_dynamic_node *left = node->child[l];
+	struct bitset_dynamic_node *right = node->child[r];
+
+	if (left->num + right->num <= BITSET_DYNAMIC_FANOUT) {
+		bitset_dynamic_move(left, right, 0, right->num);
+		node->sizes[l] += node->sizes[r];
+		node->ones[l] += node->ones[r];
+		free(right);
+		bitset_dynamic_drop_entry(node, r);
+		return;
+	}
+
+	unsigned int target = (left->num + right->num) / 2;
+	if (left->num < target)
+		bitset_dynamic_move(left, right, 0, target - left->num);
+	else {
+		/* move the tail of left to the front of right */
+		struct bitset_dynamic_node tmp;
+		tmp.num = 0;
+		bitset_dynamic_move(&tmp, left, target, left->num - target);
+		bitset_dynamic_move(&tmp, right, 0, right->num);
+		bitset_dynamic_move(right, &tmp, 0, tmp.num);
+	}
+	struct bitset_dynamic_entry el = bitset_dynamic_totals(left);
+	struct bitset_dynamic_entry er = bitset_dynamic_totals(right);
+	node->sizes[l] = el.size;
+	node->ones[l] = el.ones;
+	node->sizes[r] = er.size;
+	node->ones[r] = er.ones;
+}
+
+static
+unsigned int bitset_dynamic_erase_at(struct bitset_dynamic_node *node,
+                                     size_t index)
+{
+	unsigned int c = 0;
+	unsigned int state;
+	while (index >= node->sizes[c])
+		index -= node->sizes[c++];
+
+	if (node->leaves) {
+		struct bitset_dynamic_leaf *leaf = node->child[c];
+		state = bitset_dynamic_leaf_erase(leaf->bits, node->sizes[c], index);
+	} else
+		state = bitset_dynamic_erase_at(node->child[c], index);
+
+	--node->sizes[c];
+	node->ones[c] -= state;
+	bitset_dynamic_fix(node, c);
+	return state;
+}
+
+/* bitset_dynamic_new
+ |   creates a new, empty [struct bitset_dynamic];
+ |   returns a pointer to the allocated struct
+ */
+struct bitset_dynamic *bitset_dynamic_new()
+{
+	struct bitset_dynamic *dyn = calloc(1, sizeof(struct bitset_dynamic));
+	if (!dyn)
+		return NULL;
+	dyn->root = calloc(1, sizeof(struct bitset_dynamic_node));
+	if (!dyn->root) {
+		free(dyn);
+		return NULL;
+	}
+	dyn->root->leaves = 1;
+	dyn->height = 1;
+	return dyn;
+}
+
+/* bitset_dynamic_from(set)
+ |   creates a new [struct bitset_dynamic] holding a copy of the bits
+ |   of the passed set; the tree is built bottom-up from full leaves;
+ |   returns a pointer to the allocated struct
+ | set: valid pointer to a [struct bitset]
+ */
+struct bitset_dynamic *bitset_dynamic_from(struct bitset *set)
+{
+	struct bitset_dynamic *dyn = bitset_dynamic_new();
+	if (!dyn || !set->size)
+		return dyn;
+
+	size_t num = (set->size + BITSET_DYNAMIC_LEAF - 1) / BITSET_DYNAMIC_LEAF;
+	struct bitset_dynamic_entry *level = malloc(num * sizeof(*level));
+	if (!level) {
+		bitset_dynamic_free(dyn);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < num; ++i) {
+		struct bitset_dynamic_leaf *leaf =
+			malloc(sizeof(struct bitset_dynamic_leaf));
+		if (!leaf) {
+			while (i--)
+				free(level[i].child);
+			free(level);
+			bitset_dynamic_free(dyn);
+			return NULL;
+		}
+		for (size_t w = 0; w < BITSET_DYNAMIC_WORDS; ++w)
+			leaf->bits[w] = bitset_word(set, i * BITSET_DYNAMIC_WORDS + w);
+		level[i].child = leaf;
+		level[i].size = i + 1 < num ? BITSET_DYNAMIC_LEAF
+		              : set->size - i * BITSET_DYNAMIC_LEAF;
+		level[i].ones = bitset_dynamic_popcount(leaf->bits);
+	}
+
+	/* group entries into evenly filled nodes until one remains */
+	unsigned int leaves = 1;
+	dyn->height = 0;
+	do {
+		size_t groups = (num + BITSET_DYNAMIC_FANOUT - 1) / BITSET_DYNAMIC_FANOUT;
+		size_t next = 0;
+		for (size_t g = 0; g < groups; ++g) {
+			size_t begin = num * g / groups;
+			size_t end = num * (g + 1) / groups;
+			struct bitset_dynamic_node *node =
+				calloc(1, sizeof(struct bitset_dynamic_node));
+			if (!node) {
+				/* entries [begin, num) are still loose */
+				for (size_t i = begin; i < num; ++i) {
+					if (leaves)
+						free(level[i].child);
+					else
+						bitset_dynamic_node_free(level[i].child);
+				}
+				for (size_t i = 0; i < next; ++i)
+					bitset_dynamic_node_free(level[i].child);
+				free(level);
+				free(dyn->root);
+				free(dyn);
+				return NULL;
+			}
+			node->leaves = leaves;
+			for (size_t i = begin; i < end; ++i)
+				bitset_dynamic_put_entry(node, node->num, level[i]);
+			level[next++] = bitset_dynamic_totals(node);
+		}
+		num = next;
+		leaves = 0;
+		++dyn->height;
+	} while (num > 1);
+
+	free(dyn->root);
+	dyn->root = level[0].child;
+	dyn->size = level[0].size;
+	dyn->ones = level[0].ones;
+	free(level);
+	return dyn;
+}
+
+/* bitset_dynamic_free(dyn)
+ |   frees memory associated with the given bit vector
+ | dyn: pointer to a [struct bitset_dynamic]
+ */
+void bitset_dynamic_free(struct bitset_dynamic *dyn)
+{
+	bitset_dynamic_node_free(dyn->root);
+	while (dyn->spare) {
+		struct bitset_dynamic_node *next = dyn->spare->child[0];
+		free(dyn->spare);
+		dyn->spare = next;
+	}
+	free(dyn->spare_leaf);
+	free(dyn);
+}
+
+static
+void bitset_dynamic_to_at(struct bitset_dynamic_node *node,
+                          struct bitset *set, size_t *pos)
+{
+	for (unsigned int c = 0; c < node->num; ++c) {
+		if (!node->leaves) {
+			bitset_dynamic_to_at(node->child[c], set, pos);
+			continue;
+		}
+		struct bitset_dynamic_leaf *leaf = node->child[c];
+		unsigned char buf[BITSET_DYNAMIC_LEAF / 8];
+		for (size_t w = 0; w < BITSET_DYNAMIC_WORDS; ++w)
+			bitset_internal_store(buf + w * 8, leaf->bits[w], 8);
+		bitset_write(set, *pos, buf, node->sizes[c]);
+		*pos += node->sizes[c];
+	}
+}
+
+/* bitset_dynamic_to(dyn, set)
+ |   copies the bits of the bit vector into a bitset,
+ |   resizing the bitset to the size of the bit vector;
+ |   returns the number of bits copied
+ | dyn: valid pointer to a [struct bitset_dynamic]
+ | set: valid pointer to a [struct bitset]
+ */
+size_t bitset_dynamic_to(struct bitset_dynamic *dyn, struct bitset *set)
+{
+	size_t pos = 0;
+	if (!dyn->size) {
+		/* bitset_resize cannot shrink to zero bytes, the memory is kept */
+		size_t old = set->size;
+		set->size = 0;
+		set->count = 0;
+		bitset_prefix_resize(set, old);
+		return 0;
+	}
+	bitset_resize(set, dyn->size);
+	if (!set->data)
+		return 0;
+	bitset_dynamic_to_at(dyn->root, set, &pos);
+	return pos;
+}
+
+/* bitset_dynamic_insert(dyn, index, state)
+ |   inserts a bit before the specified index, shifting all following
+ |   bits up by one; index may equal the size to append;
+ |   returns 1 on success, 0 if memory could not be allocated
+ |   (the bit vector is left unchanged)
+ | dyn:   valid pointer to a [struct bitset_dynamic]
+ | index: position of the new bit, at most the size
+ | state: a boolean value expressing the new bit's state
+ */
+int bitset_dynamic_insert(struct bitset_dynamic *dyn, size_t index,
+                          unsigned int state)
+{
+	if (!bitset_dynamic_reserve(dyn))
+		return 0;
+
+	struct bitset_dynamic_node *root = dyn->root;
+	if (!root->num) {
+		struct bitset_dynamic_entry e = {
+			bitset_dynamic_take_leaf(dyn), 0, 0
+		};
+		bitset_dynamic_put_entry(root, 0, e);
+	}
+
+	struct bitset_dynamic_node *right =
+		bitset_dynamic_insert_at(dyn, root, index, state);
+	if (right) {
+		struct bitset_dynamic_node *top = bitset_dynamic_take(dyn, 0);
+		struct bitset_dynamic_entry e = bitset_dynamic_totals(root);
+		bitset_dynamic_put_entry(top, 0, e);
+		e = bitset_dynamic_totals(right);
+		bitset_dynamic_put_entry(top, 1, e);
+		dyn->root = top;
+		++dyn->height;
+	}
+
+	++dyn->size;
+	dyn->ones += !!state;
+	return 1;
+}
+
+/* bitset_dynamic_erase(dyn, index)
+ |   removes the bit at the specified index, shifting all following
+ |   bits down by one
+ | dyn:   valid pointer to a [struct bitset_dynamic]
+ | index: position of the bit, smaller than the size
+ */
+void bitset_dynamic_erase(struct bitset_dynamic *dyn, size_t index)
+{
+	dyn->ones -= bitset_dynamic_erase_at(dyn->root, index);
+	--dyn->size;
+
+	while (!dyn->root->leaves && dyn->root->num == 1) {
+		struct bitset_dynamic_node *root = dyn->root;
+		dyn->root = root->child[0];
+		free(root);
+		--dyn->height;
+	}
+}
+
+static
+int bitset_dynamic_set_at(struct bitset_dynamic_node *node, size_t index,
+                          unsigned int state)
+{
+	unsigned int c = 0;
+	int delta;
+	while (index >= node->sizes[c])
+		index -= node->sizes[c++];
+
+	if (node->leaves) {
+		struct bitset_dynamic_leaf *leaf = node->child[c];
+		uint64_t *word = leaf->bits + (index >> 6);
+		uint64_t bit = (uint64_t)1 << (index & 0x3f);
+		delta = (int)!!state - (int)!!(*word & bit);
+		*word = state ? *word | bit : *word & ~bit;
+	} else
+		delta = bitset_dynamic_set_at(node->child[c], index, state);
+
+	node->ones[c] += delta;
+	return delta;
+}
+
+/* bitset_dynamic_set(dyn, index, state)
+ |   sets a bit to the specified state
+ | dyn:   valid pointer to a [struct bitset_dynamic]
+ | index: position of the bit, smaller than the size
+ | state: a boolean value expressing the specified bit's new state
+ */
+void bitset_dynamic_set(struct bitset_dynamic *dyn, size_t index,
+                        unsigned int state)
+{
+	dyn->ones += bitset_dynamic_set_at(dyn->root, index, state);
+}
+
+/* bitset_dynamic_get(dyn, index)
+ |   gets the state of a bit
+ | dyn:   valid pointer to a [struct bitset_dynamic]
+ | index: position of the bit, smaller than the size
+ */
+unsigned int bitset_dynamic_get(struct bitset_dynamic *dyn, size_t index)
+{
+	struct bitset_dynamic_node *node = dyn->root;
+	for (;;) {
+		unsigned int c = 0;
+		while (index >= node->sizes[c])
+			index -= node->sizes[c++];
+		if (node->leaves) {
+			struct bitset_dynamic_leaf *leaf = node->child[c];
+			return leaf->bits[index >> 6] >> (index & 0x3f) & 1;
+		}
+		node = node->child[c];
+	}
+}
+
+/* bitset_dynamic_rank(dyn, index)
+ |   returns the number of set bits before the specified index
+ | dyn:   valid pointer to a [struct bitset_dynamic]
+ | index: position up to which to count (exclusive), at most the size
+ */
+size_t bitset_dynamic_rank(struct bitset_dynamic *dyn, size_t index)
+{
+	struct bitset_dynamic_node *node = dyn->root;
+	size_t rank = 0;
+	if (index >= dyn->size)
+		return dyn->ones;
+
+	for (;;) {
+		unsigned int c = 0;
+		for (; index >= node->sizes[c]; ++c) {
+			index -= node->sizes[c];
+			rank += node->ones[c];
+		}
+		if (node->leaves) {
+			struct bitset_dynamic_leaf *leaf = node->child[c];
+			size_t w = 0;
+			for (; w < index >> 6; ++w)
+				rank += bitset_internal_popcount(leaf->bits[w]);
+			return rank + bitset_internal_popcount(leaf->bits[w] &
+				bitset_dynamic_mask(index & 0x3f));
+		}
+		node = node->child[c];
+	}
+}
+
+/* bitset_dynamic_select(dyn, rank)
+ |   returns the position of the set bit preceded by exactly rank set
+ |   bits, or SIZE_MAX if there are not enough set bits
+ | dyn:  valid pointer to a [struct bitset_dynamic]
+ | rank: number of set bits before the searched one
+ */
+size_t bitset_dynamic_select(struct bitset_dynamic *dyn, size_t rank)
+{
+	struct bitset_dynamic_node *node = dyn->root;
+	size_t pos = 0;
+	if (rank >= dyn->ones)
+		return SIZE_MAX;
+
+	for (;;) {
+		unsigned int c = 0;
+		for (; rank >= node->ones[c]; ++c) {
+			rank -= node->ones[c];
+			pos += node->sizes[c];
+		}
+		if (node->leaves) {
+			struct bitset_dynamic_leaf *leaf = node->child[c];
+			size_t w = 0;
+			for (unsigned int n;
+			     rank >= (n = bitset_internal_popcount(leaf->bits[w])); ++w)
+				rank -= n;
+			return pos + (w << 6) + bitset_internal_select(leaf->bits[w], rank);
+		}
+		node = node->child[c];
+	}
+}
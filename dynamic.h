@@ -0,0 +1,67 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef BITSET_DYNAMIC_H
+#define BITSET_DYNAMIC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitset.h"
+
+/* bits per leaf, one cache line */
+#define BITSET_DYNAMIC_LEAF 512
+/* children per inner node */
+#define BITSET_DYNAMIC_FANOUT 16
+
+/* inner node of the B-tree; sizes and ones hold the number of bits
+ | and set bits below each child so that a descent never touches
+ | the children it skips */
+struct bitset_dynamic_node {
+	unsigned int num;
+	unsigned int leaves;
+	size_t sizes[BITSET_DYNAMIC_FANOUT];
+	size_t ones[BITSET_DYNAMIC_FANOUT];
+	void *child[BITSET_DYNAMIC_FANOUT];
+};
+
+/* bit vector supporting insertion and removal of bits at arbitrary
+ | positions, access, rank and select in O(log n) */
+struct bitset_dynamic {
+	struct bitset_dynamic_node *root;
+	size_t size;
+	size_t ones;
+	unsigned int height;
+	/* nodes and a leaf reserved before every insertion, so that
+	 | splits never fail halfway through the tree */
+	struct bitset_dynamic_node *spare;
+	unsigned int spares;
+	void *spare_leaf;
+};
+
+struct bitset_dynamic *bitset_dynamic_new();
+struct bitset_dynamic *bitset_dynamic_from(struct bitset *set);
+void bitset_dynamic_free(struct bitset_dynamic *dyn);
+size_t bitset_dynamic_to(struct bitset_dynamic *dyn, struct bitset *set);
+
+int bitset_dynamic_insert(struct bitset_dynamic *dyn, size_t index,
+                          unsigned int state);
+void bitset_dynamic_erase(struct bitset_dynamic *dyn, size_t index);
+void bitset_dynamic_set(struct bitset_dynamic *dyn, size_t index,
+                        unsigned int state);
+unsigned int bitset_dynamic_get(struct bitset_dynamic *dyn, size_t index);
+size_t bitset_dynamic_rank(struct bitset_dynamic *dyn, size_t index);
+size_t bitset_dynamic_select(struct bitset_dynamic *dyn, size_t rank);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BITSET_DYNAMIC_H */
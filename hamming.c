@@ -0,0 +1,426 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset.h"
+#include "hamming.h"
+#include "internal.c"
+
+#define BITSET_HAMMING_NONE SIZE_MAX
+
+/* bounded max-heap of (distance, id) pairs keeping the k nearest */
+struct bitset_hamming_heap {
+	size_t *ids;
+	size_t *dists;
+	size_t size;
+	size_t k;
+};
+
+/* moves (id, dist) down from slot i within the first num slots */
+static
+void bitset_hamming_heap_down(struct bitset_hamming_heap *heap, size_t i,
+                              size_t num, size_t id, size_t dist)
+{
+	for (;;) {
+		size_t child = 2 * i + 1;
+		if (child >= num)
+			break;
+		if (child + 1 < num && heap->dists[child + 1] > heap->dists[child])
+			++child;
+		if (heap->dists[child] <= dist)
+			break;
+		heap->ids[i] = heap->ids[child];
+		heap->dists[i] = heap->dists[child];
+		i = child;
+	}
+	heap->ids[i] = id;
+	heap->dists[i] = dist;
+}
+
+static
+void bitset_hamming_heap_push(struct bitset_hamming_heap *heap,
+                              size_t id, size_t dist)
+{
+	if (heap->size == heap->k) {
+		if (heap->k && dist < heap->dists[0])
+			bitset_hamming_heap_down(heap, 0, heap->size, id, dist);
+		return;
+	}
+
+	size_t i = heap->size++;
+	for (; i; ) {
+		size_t parent = (i - 1) / 2;
+		if (heap->dists[parent] >= dist)
+			break;
+		heap->ids[i] = heap->ids[parent];
+		heap->dists[i] = heap->dists[parent];
+		i = parent;
+	}
+	heap->ids[i] = id;
+	heap->dists[i] = dist;
+}
+
+/* turns the heap into an array sorted by ascending distance */
+static
+size_t bitset_hamming_heap_sort(struct bitset_hamming_heap *heap)
+{
+	for (size_t last = heap->size; last-- > 1; ) {
+		size_t id = heap->ids[last], dist = heap->dists[last];
+		heap->ids[last] = heap->ids[0];
+		heap->dists[last] = heap->dists[0];
+		bitset_hamming_heap_down(heap, 0, last, id, dist);
+	}
+	return heap->size;
+}
+
+static inline
+size_t bitset_hamming_xor(const uint64_t *a, const uint64_t *b, size_t words)
+{
+	size_t dist = 0;
+	for (size_t i = 0; i < words; ++i)
+		dist += bitset_internal_popcount(a[i] ^ b[i]);
+	return dist;
+}
+
+/* extracts len (at most 64) bits starting at bit begin */
+static inline
+uint64_t bitset_hamming_sub(const uint64_t *code, size_t begin, size_t len)
+{
+	size_t word = begin >> 6;
+	unsigned int shift = begin & 0x3f;
+	uint64_t x = code[word] >> shift;
+	if (shift && shift + len > 64)
+		x |= code[word + 1] << (64 - shift);
+	return len < 64 ? x & ~(~(uint64_t)0 << len) : x;
+}
+
+static inline
+size_t bitset_hamming_bucket(struct bitset_hamming *index,
+                             unsigned int part, uint64_t key)
+{
+	key ^= (uint64_t)part * 0x9e3779b97f4a7c15ULL;
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	return part * index->buckets + (key & (index->buckets - 1));
+}
+
+static inline
+size_t bitset_hamming_part_begin(struct bitset_hamming *index,
+                                 unsigned int part)
+{
+	return index->bits * part / index->parts;
+}
+
+/* number of masks of s bits within len bits, C(len, s), or limit + 1
+ | if there are more than limit */
+static inline
+size_t bitset_hamming_masks(size_t len, size_t s, size_t limit)
+{
+	size_t num = 1;
+	for (size_t i = 1; i <= s; ++i) {
+		if (num > limit / (len - s + i))
+			return limit + 1;
+		num = num * (len - s + i) / i;
+	}
+	return num;
+}
+
+static
+void bitset_hamming_link(struct bitset_hamming *index, size_t id)
+{
+	const uint64_t *code = index->codes + id * index->words;
+	for (unsigned int p = 0; p < index->parts; ++p) {
+		size_t begin = bitset_hamming_part_begin(index, p);
+		size_t len = bitset_hamming_part_begin(index, p + 1) - begin;
+		size_t b = bitset_hamming_bucket(index, p,
+			bitset_hamming_sub(code, begin, len));
+		index->next[id * index->parts + p] = index->heads[b];
+		index->heads[b] = id;
+	}
+}
+
+/* bitset_hamming_new(bits, parts)
+ |   creates an empty index for codes of the specified length;
+ |   returns a pointer to the allocated index
+ | bits:  length of every code in bits
+ | parts: number of substrings for multi-index hashing, 0 for an index
+ |          that only supports bitset_hamming_scan; every substring
+ |          must be at most 64 bits long, so parts >= bits / 64
+ */
+struct bitset_hamming *bitset_hamming_new(size_t bits, unsigned int parts)
+{
+	if (parts && (bits + parts - 1) / parts > 64)
+		return NULL;
+	if (parts > bits)
+		return NULL;
+
+	struct bitset_hamming *index = calloc(1, sizeof(struct bitset_hamming));
+	if (!index)
+		return NULL;
+	index->bits = bits;
+	index->words = bitset_internal_words(bits);
+	index->parts = parts;
+	if (parts) {
+		index->buckets = 16;
+		index->heads = malloc(parts * index->buckets * sizeof(size_t));
+		index->seen = bitset_new();
+		if (!index->heads || !index->seen) {
+			bitset_hamming_free(index);
+			return NULL;
+		}
+		memset(index->heads, 0xff, parts * index->buckets * sizeof(size_t));
+	}
+	return index;
+}
+
+/* bitset_hamming_free(index)
+ |   frees memory associated with the given index
+ | index: pointer to a [struct bitset_hamming]
+ */
+void bitset_hamming_free(struct bitset_hamming *index)
+{
+	free(index->codes);
+	free(index->heads);
+	free(index->next);
+	free(index->touched);
+	if (index->seen)
+		bitset_free(index->seen);
+	free(index);
+}
+
+static
+int bitset_hamming_grow(struct bitset_hamming *index)
+{
+	size_t capacity = index->capacity ? index->capacity * 2 : 64;
+	uint64_t *codes = realloc(index->codes,
+	                          capacity * index->words * sizeof(uint64_t));
+	if (!codes)
+		return 0;
+	index->codes = codes;
+	if (index->parts) {
+		size_t *next = realloc(index->next,
+		                       capacity * index->parts * sizeof(size_t));
+		if (!next)
+			return 0;
+		index->next = next;
+		size_t *touched = realloc(index->touched, capacity * sizeof(size_t));
+		if (!touched)
+			return 0;
+		index->touched = touched;
+		/* reserve keeps the old data if it fails, resize would not */
+		size_t seen = index->seen->size;
+		if (!bitset_reserve(index->seen, capacity))
+			return 0;
+		index->seen->size = capacity;
+		bitset_rclear(index->seen, seen, capacity);
+	}
+	index->capacity = capacity;
+	return 1;
+}
+
+static
+int bitset_hamming_rehash(struct bitset_hamming *index)
+{
+	size_t buckets = index->buckets * 2;
+	size_t *heads = realloc(index->heads,
+	                        index->parts * buckets * sizeof(size_t));
+	if (!heads)
+		return 0;
+	index->heads = heads;
+	index->buckets = buckets;
+	memset(heads, 0xff, index->parts * buckets * sizeof(size_t));
+	for (size_t id = 0; id < index->num; ++id)
+		bitset_hamming_link(index, id);
+	return 1;
+}
+
+/* bitset_hamming_add(index, code)
+ |   adds a code to the index; bits beyond the code length of the index
+ |   are ignored, missing bits read as zero;
+ |   returns the id of the code (ids are assigned sequentially from 0)
+ |   or SIZE_MAX if memory could not be allocated
+ | index: valid pointer to a [struct bitset_hamming]
+ | code:  valid pointer to a [struct bitset]
+ */
+size_t bitset_hamming_add(struct bitset_hamming *index, struct bitset *code)
+{
+	if (index->num == index->capacity && !bitset_hamming_grow(index))
+		return BITSET_HAMMING_NONE;
+	if (index->parts && index->num >= index->buckets &&
+	    !bitset_hamming_rehash(index))
+		return BITSET_HAMMING_NONE;
+
+	size_t id = index->num++;
+	uint64_t *dst = index->codes + id * index->words;
+	for (size_t i = 0; i < index->words; ++i)
+		dst[i] = bitset_word(code, i);
+	if (index->bits & 0x3f)
+		dst[index->words - 1] &= ~(~(uint64_t)0 << (index->bits & 0x3f));
+	if (index->parts)
+		bitset_hamming_link(index, id);
+	return id;
+}
+
+/* bitset_hamming_distance(a, b)
+ |   returns the number of positions at which the two bitsets differ;
+ |   the shorter bitset is treated as zero-extended
+ | a: valid pointer to a [struct bitset]
+ | b: valid pointer to a [struct bitset]
+ */
+size_t bitset_hamming_distance(struct bitset *a, struct bitset *b)
+{
+	size_t size = a->size > b->size ? a->size : b->size;
+	size_t words = bitset_internal_words(size);
+	size_t dist = 0;
+	for (size_t i = 0; i < words; ++i)
+		dist += bitset_internal_popcount(bitset_word(a, i) ^ bitset_word(b, i));
+	return dist;
+}
+
+static
+void bitset_hamming_query(struct bitset_hamming *index, struct bitset *query,
+                          uint64_t *q)
+{
+	for (size_t i = 0; i < index->words; ++i)
+		q[i] = bitset_word(query, i);
+	if (index->bits & 0x3f)
+		q[index->words - 1] &= ~(~(uint64_t)0 << (index->bits & 0x3f));
+}
+
+static
+void bitset_hamming_scan_all(struct bitset_hamming *index, const uint64_t *q,
+                             struct bitset_hamming_heap *heap)
+{
+	const uint64_t *code = index->codes;
+	for (size_t id = 0; id < index->num; ++id, code += index->words)
+		bitset_hamming_heap_push(heap, id,
+			bitset_hamming_xor(q, code, index->words));
+}
+
+/* bitset_hamming_scan(index, query, k, ids, dists)
+ |   finds the k codes nearest to the query by comparing it against
+ |   every code (popcount of XOR over whole words);
+ |   returns the number of results, min(k, number of codes), sorted by
+ |   ascending distance; ties are resolved arbitrarily
+ | index: valid pointer to a [struct bitset_hamming]
+ | query: valid pointer to a [struct bitset]
+ | k:     maximum number of results
+ | ids:   pointer to memory for k ids
+ | dists: pointer to memory for k distances
+ */
+size_t bitset_hamming_scan(struct bitset_hamming *index, struct bitset *query,
+                           size_t k, size_t *ids, size_t *dists)
+{
+	uint64_t *q = malloc((index->words ? index->words : 1) * sizeof(uint64_t));
+	if (!q)
+		return 0;
+	struct bitset_hamming_heap heap = { ids, dists, 0, k };
+	bitset_hamming_query(index, query, q);
+	bitset_hamming_scan_all(index, q, &heap);
+	free(q);
+	return bitset_hamming_heap_sort(&heap);
+}
+
+/* bitset_hamming_search(index, query, k, ids, dists)
+ |   finds the k codes nearest to the query using multi-index hashing:
+ |   the substrings of the query are probed at increasing radius s,
+ |   which finds every code within distance parts * (s + 1) - 1, until
+ |   the k-th best distance is within that bound. Falls back to a full
+ |   scan once probing would touch more buckets than there are codes;
+ |   results are exact and equal to those of bitset_hamming_scan up to
+ |   the order of ties;
+ |   returns the number of results, min(k, number of codes), sorted by
+ |   ascending distance
+ | index: valid pointer to a [struct bitset_hamming] with parts > 0
+ | query: valid pointer to a [struct bitset]
+ | k:     maximum number of results
+ | ids:   pointer to memory for k ids
+ | dists: pointer to memory for k distances
+ */
+size_t bitset_hamming_search(struct bitset_hamming *index,
+                             struct bitset *query, size_t k,
+                             size_t *ids, size_t *dists)
+{
+	if (!index->parts)
+		return bitset_hamming_scan(index, query, k, ids, dists);
+
+	uint64_t *q = malloc((index->words ? index->words : 1) * sizeof(uint64_t));
+	if (!q)
+		return 0;
+	struct bitset_hamming_heap heap = { ids, dists, 0, k };
+	size_t touched = 0;
+	size_t probes = 0;
+	size_t max_len = (index->bits + index->parts - 1) / index->parts;
+	bitset_hamming_query(index, query, q);
+	if (k > index->num)
+		k = index->num;
+
+	for (size_t s = 0; s <= max_len; ++s) {
+		/* probing the next radius would touch more buckets than a scan
+		 | touches codes */
+		size_t cost = probes;
+		for (unsigned int p = 0; p < index->parts && cost <= index->num;
+		     ++p) {
+			size_t len = bitset_hamming_part_begin(index, p + 1) -
+			             bitset_hamming_part_begin(index, p);
+			if (s <= len)
+				cost += bitset_hamming_masks(len, s, index->num);
+		}
+		if (cost > index->num) {
+			heap.size = 0;
+			bitset_hamming_scan_all(index, q, &heap);
+			break;
+		}
+
+		for (unsigned int p = 0; p < index->parts; ++p) {
+			size_t begin = bitset_hamming_part_begin(index, p);
+			size_t len = bitset_hamming_part_begin(index, p + 1) - begin;
+			if (s > len)
+				continue;
+			uint64_t key = bitset_hamming_sub(q, begin, len);
+			uint64_t last = s ? ~(uint64_t)0 >> (64 - s) << (len - s) : 0;
+
+			/* enumerate all masks of s bits within len bits */
+			for (uint64_t m = s ? ~(uint64_t)0 >> (64 - s) : 0; ; ) {
+				uint64_t probe = key ^ m;
+				size_t b = bitset_hamming_bucket(index, p, probe);
+				size_t id = index->heads[b];
+				for (; id != BITSET_HAMMING_NONE;
+				     id = index->next[id * index->parts + p]) {
+					const uint64_t *code = index->codes + id * index->words;
+					if (bitset_get(index->seen, id) ||
+					    bitset_hamming_sub(code, begin, len) != probe)
+						continue;
+					bitset_set(index->seen, id, 1);
+					index->touched[touched++] = id;
+					bitset_hamming_heap_push(&heap, id,
+						bitset_hamming_xor(q, code, index->words));
+				}
+				++probes;
+				if (m == last)
+					break;
+				/* next mask with the same popcount (Gosper's hack) */
+				uint64_t c = m & -m;
+				uint64_t r = m + c;
+				m = (((r ^ m) >> 2) / c) | r;
+			}
+		}
+
+		size_t bound = index->parts * (s + 1) - 1;
+		if (heap.size >= k && (!k || heap.dists[0] <= bound))
+			break;
+	}
+
+	for (size_t i = 0; i < touched; ++i)
+		bitset_set(index->seen, index->touched[i], 0);
+	free(q);
+	return bitset_hamming_heap_sort(&heap);
+}
@@ -0,0 +1,52 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef BITSET_HAMMING_H
+#define BITSET_HAMMING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitset.h"
+
+/* index over fixed-length codes for nearest-neighbour search by
+ | Hamming distance; with parts > 0 every code is additionally split
+ | into that many substrings, each kept in its own hash table
+ | (multi-index hashing) */
+struct bitset_hamming {
+	uint64_t *codes;
+	size_t bits;
+	size_t words;
+	size_t num;
+	size_t capacity;
+	unsigned int parts;
+	size_t buckets;
+	size_t *heads;
+	size_t *next;
+	struct bitset *seen;
+	size_t *touched;
+};
+
+struct bitset_hamming *bitset_hamming_new(size_t bits, unsigned int parts);
+void bitset_hamming_free(struct bitset_hamming *index);
+size_t bitset_hamming_add(struct bitset_hamming *index, struct bitset *code);
+
+size_t bitset_hamming_distance(struct bitset *a, struct bitset *b);
+size_t bitset_hamming_scan(struct bitset_hamming *index, struct bitset *query,
+                           size_t k, size_t *ids, size_t *dists);
+size_t bitset_hamming_search(struct bitset_hamming *index,
+                             struct bitset *query, size_t k,
+                             size_t *ids, size_t *dists);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BITSET_HAMMING_H */
@@ -6,3 +6,119 @@
 
 #define bitset_internal_alloc(clear, num, size) \
 	((clear) ? calloc(num, size) : malloc((num) * (size)))
+
+#define bitset_internal_words(bits) \
+	(((bits) + 63) >> 6)
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define bitset_internal_le64(x) __builtin_bswap64(x)
+#else
+#define bitset_internal_le64(x) (x)
+#endif
+
+static inline
+unsigned int bitset_internal_popcount(uint64_t x)
+{
+#if defined(__GNUC__)
+	return __builtin_popcountll(x);
+#else
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return (x * 0x0101010101010101ULL) >> 56;
+#endif
+}
+
+/* x must not be zero */
+static inline
+unsigned int bitset_internal_ctz(uint64_t x)
+{
+#if defined(__GNUC__)
+	return __builtin_ctzll(x);
+#else
+	unsigned int n = 0;
+	for (; !(x & 1); x >>= 1)
+		++n;
+	return n;
+#endif
+}
+
+/* x must not be zero */
+static inline
+unsigned int bitset_internal_clz(uint64_t x)
+{
+#if defined(__GNUC__)
+	return __builtin_clzll(x);
+#else
+	unsigned int n = 0;
+	for (; !(x >> 63); x <<= 1)
+		++n;
+	return n;
+#endif
+}
+
+/* loads num (at most 8) bytes as a little-endian word;
+ | bit i of the word is bit i of the byte sequence */
+static inline
+uint64_t bitset_internal_load(const unsigned char *ptr, size_t num)
+{
+	uint64_t word = 0;
+	if (num >= 8) {
+		memcpy(&word, ptr, 8);
+		return bitset_internal_le64(word);
+	}
+	for (size_t i = 0; i < num; ++i)
+		word |= (uint64_t)ptr[i] << (i * 8);
+	return word;
+}
+
+/* stores the lower num (at most 8) bytes of a word, little-endian */
+static inline
+void bitset_internal_store(unsigned char *ptr, uint64_t word, size_t num)
+{
+	if (num >= 8) {
+		word = bitset_internal_le64(word);
+		memcpy(ptr, &word, 8);
+		return;
+	}
+	for (size_t i = 0; i < num; ++i)
+		ptr[i] = word >> (i * 8);
+}
+
+/* returns the position of the (rank + 1)-th set bit; rank must be
+ | smaller than the popcount of the word */
+static inline
+unsigned int bitset_internal_select(uint64_t word, unsigned int rank)
+{
+	unsigned int base = 0;
+	for (unsigned int c; rank >= (c = bitset_internal_popcount(word & 0xff));
+	     rank -= c, word >>= 8, base += 8)
+		;
+	for (; rank; --rank)
+		word &= word - 1;
+	return base + bitset_internal_ctz(word);
+}
+
+/* reverses the bit order within every byte of a word */
+static inline
+uint64_t bitset_internal_rev8x8(uint64_t x)
+{
+	x = (x >> 1 & 0x5555555555555555ULL) | (x & 0x5555555555555555ULL) << 1;
+	x = (x >> 2 & 0x3333333333333333ULL) | (x & 0x3333333333333333ULL) << 2;
+	x = (x >> 4 & 0x0f0f0f0f0f0f0f0fULL) | (x & 0x0f0f0f0f0f0f0f0fULL) << 4;
+	return x;
+}
+
+/* reverses the bit order of a word */
+static inline
+uint64_t bitset_internal_rev64(uint64_t x)
+{
+	x = bitset_internal_rev8x8(x);
+#if defined(__GNUC__)
+	return __builtin_bswap64(x);
+#else
+	x = (x >> 8 & 0x00ff00ff00ff00ffULL) | (x & 0x00ff00ff00ff00ffULL) << 8;
+	x = (x >> 16 & 0x0000ffff0000ffffULL) | (x & 0x0000ffff0000ffffULL) << 16;
+	return x >> 32 | x << 32;
+#endif
+}
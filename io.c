@@ -0,0 +1,395 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+#endif
+
+#include "bitset.h"
+#include "io.h"
+#include "internal.c"
+
+#if defined(IORING_OFF_SQES) && defined(__NR_io_uring_setup)
+#define BITSET_IO_URING 1
+#endif
+
+static const char bitset_io_magic[8] = "bitset";
+
+/* one transfer of len bytes between buf and the file at offset, split
+ | into chunks that are issued in parallel */
+struct bitset_io_job {
+	int fd;
+	int write;
+	unsigned char *buf;
+	size_t len;
+	off_t offset;
+	size_t chunk;
+	size_t chunks;
+	size_t next;
+	int failed;
+};
+
+static inline
+size_t bitset_io_chunk_len(struct bitset_io_job *job, size_t c)
+{
+	size_t begin = c * job->chunk;
+	return job->len - begin < job->chunk ? job->len - begin : job->chunk;
+}
+
+/* pread/pwrite fallback: every thread takes the next chunk until none
+ | are left */
+static
+void *bitset_io_worker(void *arg)
+{
+	struct bitset_io_job *job = arg;
+	size_t c;
+	while (!__atomic_load_n(&job->failed, __ATOMIC_RELAXED) &&
+	       (c = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->chunks) {
+		size_t len = bitset_io_chunk_len(job, c);
+		size_t done = 0;
+		while (done < len) {
+			unsigned char *ptr = job->buf + c * job->chunk + done;
+			off_t at = job->offset + c * job->chunk + done;
+			ssize_t n = job->write ? pwrite(job->fd, ptr, len - done, at)
+			                       : pread(job->fd, ptr, len - done, at);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0) {
+				__atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+				return NULL;
+			}
+			done += n;
+		}
+	}
+	return NULL;
+}
+
+static
+int bitset_io_threads(struct bitset_io_job *job, unsigned int threads)
+{
+	if (threads > BITSET_IO_MAX_THREADS)
+		threads = BITSET_IO_MAX_THREADS;
+	if (threads > job->chunks)
+		threads = job->chunks;
+	if (!threads)
+		threads = 1;
+	pthread_t tids[threads];
+	unsigned int started = 1;
+	for (; started < threads; ++started)
+		if (pthread_create(tids + started, NULL, bitset_io_worker, job))
+			break;
+	bitset_io_worker(job);
+	for (unsigned int t = 1; t < started; ++t)
+		pthread_join(tids[t], NULL);
+	return !job->failed;
+}
+
+#if defined(BITSET_IO_URING)
+
+/* submission and completion rings shared with the kernel */
+struct bitset_io_ring {
+	int fd;
+	unsigned int entries;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	struct io_uring_sqe *sqes;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+	void *sq_ptr;
+	void *cq_ptr;
+	size_t sq_len;
+	size_t cq_len;
+	size_t sqes_len;
+};
+
+static
+void bitset_io_ring_exit(struct bitset_io_ring *ring)
+{
+	if (ring->sqes && ring->sqes != MAP_FAILED)
+		munmap(ring->sqes, ring->sqes_len);
+	if (ring->cq_ptr && ring->cq_ptr != MAP_FAILED && ring->cq_ptr != ring->sq_ptr)
+		munmap(ring->cq_ptr, ring->cq_len);
+	if (ring->sq_ptr && ring->sq_ptr != MAP_FAILED)
+		munmap(ring->sq_ptr, ring->sq_len);
+	close(ring->fd);
+}
+
+/* returns 0 if io_uring is not available, e.g. on older kernels or
+ | when it is disabled */
+static
+int bitset_io_ring_init(struct bitset_io_ring *ring, unsigned int depth)
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	memset(ring, 0, sizeof(struct bitset_io_ring));
+	ring->fd = syscall(__NR_io_uring_setup, depth, &params);
+	if (ring->fd < 0)
+		return 0;
+
+	ring->entries = params.sq_entries;
+	ring->sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	ring->cq_len = params.cq_off.cqes +
+	               params.cq_entries * sizeof(struct io_uring_cqe);
+	int single = params.features & IORING_FEAT_SINGLE_MMAP;
+	if (single && ring->cq_len > ring->sq_len)
+		ring->sq_len = ring->cq_len;
+
+	ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE,
+	                    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	ring->cq_ptr = single ? ring->sq_ptr
+	             : mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE,
+	                    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+	ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+	                  MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sq_ptr == MAP_FAILED || ring->cq_ptr == MAP_FAILED ||
+	    ring->sqes == MAP_FAILED) {
+		bitset_io_ring_exit(ring);
+		return 0;
+	}
+
+	unsigned char *sq = ring->sq_ptr, *cq = ring->cq_ptr;
+	ring->sq_tail = (unsigned int *)(sq + params.sq_off.tail);
+	ring->sq_mask = (unsigned int *)(sq + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned int *)(sq + params.sq_off.array);
+	ring->cq_head = (unsigned int *)(cq + params.cq_off.head);
+	ring->cq_tail = (unsigned int *)(cq + params.cq_off.tail);
+	ring->cq_mask = (unsigned int *)(cq + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+	return 1;
+}
+
+/* keeps up to depth chunks in flight; short transfers are resubmitted
+ | for their remainder. All requests are completed before it returns,
+ | also on failure, since the kernel still writes to the buffer */
+static
+int bitset_io_uring(struct bitset_io_ring *ring, struct bitset_io_job *job)
+{
+	size_t *done = calloc(job->chunks, sizeof(size_t));
+	size_t *retry = malloc(job->chunks * sizeof(size_t));
+	if (!done || !retry) {
+		free(done);
+		free(retry);
+		return 0;
+	}
+
+	size_t completed = 0, retries = 0;
+	unsigned int inflight = 0, unsubmitted = 0;
+	while ((completed < job->chunks && !job->failed) || inflight) {
+		unsigned int tail = *ring->sq_tail;
+		while (!job->failed && inflight < ring->entries &&
+		       (retries || job->next < job->chunks)) {
+			size_t c = retries ? retry[--retries] : job->next++;
+			struct io_uring_sqe *sqe = ring->sqes + (tail & *ring->sq_mask);
+			memset(sqe, 0, sizeof(struct io_uring_sqe));
+			sqe->opcode = job->write ? IORING_OP_WRITE : IORING_OP_READ;
+			sqe->fd = job->fd;
+			sqe->addr = (uintptr_t)(job->buf + c * job->chunk + done[c]);
+			sqe->len = bitset_io_chunk_len(job, c) - done[c];
+			sqe->off = job->offset + c * job->chunk + done[c];
+			sqe->user_data = c;
+			ring->sq_array[tail & *ring->sq_mask] = tail & *ring->sq_mask;
+			++tail;
+			++inflight;
+			++unsubmitted;
+		}
+		__atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+		int n = syscall(__NR_io_uring_enter, ring->fd, unsubmitted, 1,
+		                IORING_ENTER_GETEVENTS, NULL, 0);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			/* nothing can be waited for anymore */
+			job->failed = 1;
+			break;
+		}
+		unsubmitted -= n;
+
+		unsigned int head = *ring->cq_head;
+		unsigned int end = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+		for (; head != end; ++head) {
+			struct io_uring_cqe *cqe = ring->cqes + (head & *ring->cq_mask);
+			size_t c = cqe->user_data;
+			--inflight;
+			if (cqe->res == -EAGAIN || cqe->res == -EINTR)
+				retry[retries++] = c;
+			else if (cqe->res <= 0)
+				job->failed = 1;
+			else if ((done[c] += cqe->res) < bitset_io_chunk_len(job, c))
+				retry[retries++] = c;
+			else
+				++completed;
+		}
+		__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	free(done);
+	free(retry);
+	return !job->failed;
+}
+
+#endif /* BITSET_IO_URING */
+
+/* transfers len bytes with io_uring if it can be set up, with a pool of
+ | pread/pwrite threads otherwise */
+static
+int bitset_io_run(int fd, int write, unsigned char *buf, size_t len,
+                  off_t offset, const struct bitset_io *options)
+{
+	size_t chunk = options && options->chunk ? options->chunk : 1 << 20;
+	chunk = (chunk + BITSET_IO_ALIGN - 1) / BITSET_IO_ALIGN * BITSET_IO_ALIGN;
+	unsigned int depth = options && options->depth ? options->depth : 32;
+	unsigned int threads = options && options->threads ? options->threads : 8;
+	if (!len)
+		return 1;
+
+	struct bitset_io_job job = {
+		fd, write, buf, len, offset, chunk, (len + chunk - 1) / chunk, 0, 0
+	};
+#if defined(BITSET_IO_URING)
+	struct bitset_io_ring ring;
+	if (bitset_io_ring_init(&ring, depth)) {
+		int ok = bitset_io_uring(&ring, &job);
+		bitset_io_ring_exit(&ring);
+		return ok;
+	}
+#else
+	(void)depth;
+#endif
+	return bitset_io_threads(&job, threads);
+}
+
+/* opens with O_DIRECT if asked for and possible, buffered otherwise */
+static
+int bitset_io_open(const char *path, int flags, int direct)
+{
+#if defined(O_DIRECT)
+	if (direct) {
+		int fd = open(path, flags | O_DIRECT, 0644);
+		if (fd >= 0 || errno != EINVAL)
+			return fd;
+	}
+#else
+	(void)direct;
+#endif
+	return open(path, flags, 0644);
+}
+
+/* bitset_store_async(set, path, options)
+ |   writes the bitset to a file, splitting the data into chunks that
+ |   are written in parallel: as batches of io_uring requests, or by a
+ |   pool of pwrite threads when io_uring is not available. O_DIRECT is
+ |   only used if the data is aligned to BITSET_IO_ALIGN and its
+ |   capacity covers the padding, as with sets from bitset_load_async;
+ |   returns 1 on success, 0 on failure
+ | set:     valid pointer to a [struct bitset]
+ | path:    name of the file, which is created or replaced
+ | options: pointer to a [struct bitset_io], or NULL for the defaults
+ */
+int bitset_store_async(struct bitset *set, const char *path,
+                       const struct bitset_io *options)
+{
+	size_t bytes = set->size ? bitset_internal_bytes(set->size) : 0;
+	size_t padded = (bytes + BITSET_IO_ALIGN - 1) / BITSET_IO_ALIGN *
+	                BITSET_IO_ALIGN;
+	int direct = options && options->direct &&
+	             !((uintptr_t)set->data % BITSET_IO_ALIGN) &&
+	             bitset_bytes(set) >= padded;
+
+	unsigned char *header;
+	if (posix_memalign((void **)&header, BITSET_IO_ALIGN, BITSET_IO_ALIGN))
+		return 0;
+	memset(header, 0, BITSET_IO_ALIGN);
+	memcpy(header, bitset_io_magic, 8);
+	uint64_t size = bitset_internal_le64((uint64_t)set->size);
+	memcpy(header + 8, &size, 8);
+
+	int fd = bitset_io_open(path, O_WRONLY | O_CREAT | O_TRUNC, direct);
+	int ok = fd >= 0 &&
+	         pwrite(fd, header, BITSET_IO_ALIGN, 0) == BITSET_IO_ALIGN &&
+	         bitset_io_run(fd, 1, set->data, direct ? padded : bytes,
+	                       BITSET_IO_ALIGN, options) &&
+	         !ftruncate(fd, BITSET_IO_ALIGN + padded);
+	if (fd >= 0 && close(fd))
+		ok = 0;
+	free(header);
+	return ok;
+}
+
+/* bitset_load_async(path, options)
+ |   reads a bitset written by bitset_store_async into memory aligned
+ |   to BITSET_IO_ALIGN, in chunks that are read in parallel like in
+ |   bitset_store_async;
+ |   returns a pointer to the allocated struct, or NULL on failure
+ | path:    name of the file
+ | options: pointer to a [struct bitset_io], or NULL for the defaults
+ */
+struct bitset *bitset_load_async(const char *path,
+                                 const struct bitset_io *options)
+{
+	int direct = options && options->direct;
+	int fd = bitset_io_open(path, O_RDONLY, direct);
+	if (fd < 0)
+		return NULL;
+
+	struct bitset *set = NULL;
+	unsigned char *header = NULL;
+	uint64_t size;
+	if (posix_memalign((void **)&header, BITSET_IO_ALIGN, BITSET_IO_ALIGN) ||
+	    pread(fd, header, BITSET_IO_ALIGN, 0) != BITSET_IO_ALIGN ||
+	    memcmp(header, bitset_io_magic, 8))
+		goto out;
+	memcpy(&size, header + 8, 8);
+	size = bitset_internal_le64(size);
+
+	size_t bytes = size ? bitset_internal_bytes(size) : 0;
+	size_t padded = (bytes + BITSET_IO_ALIGN - 1) / BITSET_IO_ALIGN *
+	                BITSET_IO_ALIGN;
+	struct stat st;
+	if (fstat(fd, &st) || (uint64_t)st.st_size < BITSET_IO_ALIGN + padded)
+		goto out;
+
+	set = calloc(1, sizeof(struct bitset));
+	void *data;
+	if (!set || posix_memalign(&data, BITSET_IO_ALIGN,
+	                           padded ? padded : BITSET_IO_ALIGN)) {
+		free(set);
+		set = NULL;
+		goto out;
+	}
+	set->data = data;
+	set->capacity = bitset_internal_capacity(padded ? padded : BITSET_IO_ALIGN);
+	set->size = size;
+	if (!bitset_io_run(fd, 0, set->data, padded, BITSET_IO_ALIGN, options)) {
+		bitset_free(set);
+		set = NULL;
+	}
+out:
+	free(header);
+	close(fd);
+	return set;
+}
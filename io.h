@@ -0,0 +1,47 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef BITSET_IO_H
+#define BITSET_IO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitset.h"
+
+/* alignment of the file layout and of the data for direct I/O; the file
+ | starts with one block holding "bitset\0\0" and the size in bits as a
+ | little-endian 64-bit number, followed by the data padded to a block */
+#define BITSET_IO_ALIGN 4096
+
+/* upper bound on the threads without io_uring; larger requests are
+ | capped */
+#define BITSET_IO_MAX_THREADS 256
+
+/* options of bitset_load_async and bitset_store_async; fields that are
+ | zero take the default */
+struct bitset_io {
+	size_t chunk;         /* bytes per request, default 1 MB */
+	unsigned int depth;   /* requests in flight, default 32 */
+	unsigned int threads; /* threads without io_uring, default 8, at
+	                         most BITSET_IO_MAX_THREADS */
+	unsigned int direct;  /* bypass the page cache with O_DIRECT */
+};
+
+int bitset_store_async(struct bitset *set, const char *path,
+                       const struct bitset_io *options);
+struct bitset *bitset_load_async(const char *path,
+                                 const struct bitset_io *options);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BITSET_IO_H */
@@ -0,0 +1,217 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset.h"
+#include "minhash.h"
+#include "internal.c"
+
+static inline
+uint64_t bitset_minhash_mix(uint64_t x, uint64_t seed)
+{
+	x ^= seed;
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+/* bitset_minhash(set, seed, sig, k)
+ |   computes a k-permutation MinHash signature over the set bits:
+ |   sig[j] is the minimum of the j-th hash function over all set
+ |   positions. The k functions are derived from two base hashes
+ |   (h1 + j * h2), so the inner loop is a plain 32-bit multiply-add
+ |   over the signature that compilers vectorize;
+ |   an empty set yields UINT32_MAX in every slot
+ | set:  valid pointer to a [struct bitset]
+ | seed: selects the family of hash functions
+ | sig:  pointer to memory for k values
+ | k:    number of hash functions
+ */
+void bitset_minhash(struct bitset *set, uint64_t seed,
+                    uint32_t *sig, size_t k)
+{
+	size_t words = bitset_internal_words(set->size);
+	for (size_t j = 0; j < k; ++j)
+		sig[j] = UINT32_MAX;
+
+	for (size_t i = 0; i < words; ++i) {
+		uint64_t word = bitset_word(set, i);
+		for (; word; word &= word - 1) {
+			size_t pos = (i << 6) + bitset_internal_ctz(word);
+			uint64_t h = bitset_minhash_mix(pos, seed);
+			uint32_t h1 = h;
+			uint32_t h2 = (h >> 32) | 1;
+			for (size_t j = 0; j < k; ++j) {
+				uint32_t v = h1 + (uint32_t)j * h2;
+				sig[j] = v < sig[j] ? v : sig[j];
+			}
+		}
+	}
+}
+
+/* bitset_minhash_oph(set, seed, sig, k)
+ |   computes a one-permutation MinHash signature: every set position
+ |   is hashed once and the hash space is split into k bins, each
+ |   keeping its minimum. Empty bins are filled from the next
+ |   non-empty bin (rotation densification), so signatures of
+ |   non-empty sets can be compared like k-permutation ones;
+ |   an empty set yields UINT32_MAX in every slot
+ | set:  valid pointer to a [struct bitset]
+ | seed: selects the hash function
+ | sig:  pointer to memory for k values
+ | k:    number of bins
+ */
+void bitset_minhash_oph(struct bitset *set, uint64_t seed,
+                        uint32_t *sig, size_t k)
+{
+	size_t words = bitset_internal_words(set->size);
+	size_t filled = 0;
+	for (size_t j = 0; j < k; ++j)
+		sig[j] = UINT32_MAX;
+	if (!k)
+		return;
+
+	for (size_t i = 0; i < words; ++i) {
+		uint64_t word = bitset_word(set, i);
+		for (; word; word &= word - 1) {
+			size_t pos = (i << 6) + bitset_internal_ctz(word);
+			uint64_t h = bitset_minhash_mix(pos, seed);
+			size_t bin = ((h >> 32) * (uint64_t)k) >> 32;
+			uint32_t v = h;
+			if (v < sig[bin]) {
+				filled += sig[bin] == UINT32_MAX;
+				sig[bin] = v;
+			}
+		}
+	}
+
+	if (!filled || filled == k)
+		return;
+
+	/* walk backwards from a filled bin so that every empty bin
+	 | takes the value of the nearest filled bin to its right,
+	 | offset by the distance to keep borrowed values distinct */
+	size_t src = 0;
+	while (sig[src] == UINT32_MAX)
+		++src;
+	size_t j = src;
+	uint32_t dist = 0;
+	for (size_t n = 1; n < k; ++n) {
+		j = j ? j - 1 : k - 1;
+		if (sig[j] != UINT32_MAX) {
+			src = j;
+			dist = 0;
+		} else
+			sig[j] = sig[src] + ++dist * 0x9e3779b9U;
+	}
+}
+
+/* bitset_minhash_jaccard(a, b, k)
+ |   estimates the Jaccard similarity of two sets from their
+ |   full-width signatures;
+ |   returns the fraction of equal signature values
+ | a: signature of the first set
+ | b: signature of the second set
+ | k: number of signature values
+ */
+double bitset_minhash_jaccard(const uint32_t *a, const uint32_t *b, size_t k)
+{
+	size_t matches = 0;
+	for (size_t j = 0; j < k; ++j)
+		matches += a[j] == b[j];
+	return k ? (double)matches / k : 0.0;
+}
+
+/* bitset_minhash_pack(sig, k, b, packed)
+ |   keeps only the lowest b bits of every signature value and packs
+ |   them densely, 64 / b values per word
+ | sig:    signature of k values
+ | k:      number of signature values
+ | b:      number of bits kept per value (1, 2, 4, 8, 16 or 32)
+ | packed: pointer to bitset_minhash_words(k, b) words
+ */
+void bitset_minhash_pack(const uint32_t *sig, size_t k, unsigned int b,
+                         uint64_t *packed)
+{
+	uint64_t mask = ~(~(uint64_t)0 << b);
+	size_t per_word = 64 / b;
+	memset(packed, 0, bitset_minhash_words(k, b) * sizeof(uint64_t));
+	for (size_t j = 0; j < k; ++j)
+		packed[j / per_word] |= (sig[j] & mask) << (j % per_word * b);
+}
+
+/* bitset_minhash_matches(a, b, k, b_bits)
+ |   compares two b-bit packed signatures field by field using
+ |   word-wide XOR and popcount;
+ |   returns the number of equal fields
+ | a:      first packed signature
+ | b:      second packed signature
+ | k:      number of signature values
+ | b_bits: number of bits per value the signatures were packed with
+ */
+size_t bitset_minhash_matches(const uint64_t *a, const uint64_t *b,
+                              size_t k, unsigned int b_bits)
+{
+	/* lowest bit of every field */
+	uint64_t low = ~(uint64_t)0 / ~(~(uint64_t)0 << b_bits);
+	size_t words = bitset_minhash_words(k, b_bits);
+	size_t mismatches = 0;
+
+	for (size_t i = 0; i < words; ++i) {
+		uint64_t x = a[i] ^ b[i];
+		for (unsigned int s = 1; s < b_bits; s <<= 1)
+			x |= x >> s;
+		mismatches += bitset_internal_popcount(x & low);
+	}
+	return k - mismatches;
+}
+
+/* bitset_minhash_estimate(matches, k, b)
+ |   estimates the Jaccard similarity from the number of matching
+ |   b-bit fields, correcting for the 2^-b chance that two unrelated
+ |   values agree in their lowest b bits;
+ |   returns the estimate, clamped to [0, 1]
+ | matches: number of equal fields, as from bitset_minhash_matches
+ | k:       number of signature values
+ | b:       number of bits per value
+ */
+double bitset_minhash_estimate(size_t matches, size_t k, unsigned int b)
+{
+	if (!k)
+		return 0.0;
+	double p = (double)matches / k;
+	double c = b >= 32 ? 0.0 : 1.0 / (double)((uint64_t)1 << b);
+	double j = (p - c) / (1.0 - c);
+	return j < 0.0 ? 0.0 : j;
+}
+
+/* bitset_minhash_batch(query, sigs, num, k, b, jaccard)
+ |   compares one packed signature against num packed signatures
+ |   stored back to back and estimates the Jaccard similarity
+ |   for each of them
+ | query:   packed signature to compare against
+ | sigs:    num packed signatures of bitset_minhash_words(k, b) words each
+ | num:     number of signatures in sigs
+ | k:       number of signature values
+ | b:       number of bits per value
+ | jaccard: pointer to memory for num estimates
+ */
+void bitset_minhash_batch(const uint64_t *query, const uint64_t *sigs,
+                          size_t num, size_t k, unsigned int b,
+                          double *jaccard)
+{
+	size_t words = bitset_minhash_words(k, b);
+	for (size_t i = 0; i < num; ++i, sigs += words)
+		jaccard[i] = bitset_minhash_estimate(
+			bitset_minhash_matches(query, sigs, k, b), k, b);
+}
@@ -0,0 +1,46 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef BITSET_MINHASH_H
+#define BITSET_MINHASH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitset.h"
+
+/* bitset_minhash_words(k, b)
+ |   returns the number of 64-bit words a b-bit packed signature
+ |   of k values occupies
+ | k: number of signature values
+ | b: number of bits kept per value (1, 2, 4, 8, 16 or 32)
+ */
+#define bitset_minhash_words(k, b) (((size_t)(k) * (b) + 63) / 64)
+
+void bitset_minhash(struct bitset *set, uint64_t seed,
+                    uint32_t *sig, size_t k);
+void bitset_minhash_oph(struct bitset *set, uint64_t seed,
+                        uint32_t *sig, size_t k);
+double bitset_minhash_jaccard(const uint32_t *a, const uint32_t *b, size_t k);
+
+void bitset_minhash_pack(const uint32_t *sig, size_t k, unsigned int b,
+                         uint64_t *packed);
+size_t bitset_minhash_matches(const uint64_t *a, const uint64_t *b,
+                              size_t k, unsigned int b_bits);
+double bitset_minhash_estimate(size_t matches, size_t k, unsigned int b);
+void bitset_minhash_batch(const uint64_t *query, const uint64_t *sigs,
+                          size_t num, size_t k, unsigned int b,
+                          double *jaccard);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BITSET_MINHASH_H */
@@ -0,0 +1,451 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset.h"
+#include "morph.h"
+#include "internal.c"
+
+/* a band of output rows y0 to (y1 - 1) processed by one thread */
+struct bitset_morph_job {
+	struct bitset **dst;
+	struct bitset **src;
+	size_t height;
+	size_t width;
+	size_t rx;
+	size_t ry;
+	unsigned int shape;
+	unsigned int erode;
+	size_t y0;
+	size_t y1;
+	int ok;
+	/* labeling */
+	struct bitset_morph_run *runs;
+	size_t num;
+};
+
+/* runs fn over all jobs, on threads if there is more than one */
+static
+void bitset_morph_run_jobs(void *(*fn)(void *),
+                           struct bitset_morph_job *jobs, unsigned int num)
+{
+	pthread_t tids[num > 1 ? num : 1];
+	unsigned int started = 1;
+	for (; started < num; ++started)
+		if (pthread_create(tids + started, NULL, fn, jobs + started))
+			break;
+	fn(jobs);
+	for (unsigned int t = started; t < num; ++t)
+		fn(jobs + t);
+	for (unsigned int t = 1; t < started; ++t)
+		pthread_join(tids[t], NULL);
+}
+
+/* dst = src shifted towards higher bit positions by s, the vacated
+ | positions taking the fill word */
+static
+void bitset_morph_shl(uint64_t *dst, const uint64_t *src, size_t n,
+                      size_t s, uint64_t fill)
+{
+	size_t q = s >> 6;
+	unsigned int b = s & 0x3f;
+	for (size_t i = n; i--; ) {
+		uint64_t hi = i >= q ? src[i - q] : fill;
+		uint64_t lo = i >= q + 1 ? src[i - q - 1] : fill;
+		dst[i] = b ? hi << b | lo >> (64 - b) : hi;
+	}
+}
+
+/* dst = src shifted towards lower bit positions by s */
+static
+void bitset_morph_shr(uint64_t *dst, const uint64_t *src, size_t n,
+                      size_t s, uint64_t fill)
+{
+	size_t q = s >> 6;
+	unsigned int b = s & 0x3f;
+	for (size_t i = 0; i < n; ++i) {
+		uint64_t lo = i + q < n ? src[i + q] : fill;
+		uint64_t hi = i + q + 1 < n ? src[i + q + 1] : fill;
+		dst[i] = b ? lo >> b | hi << (64 - b) : lo;
+	}
+}
+
+/* combines every pixel of a row with its neighbours up to r columns
+ | away, doubling the covered radius with every step */
+static
+void bitset_morph_row(uint64_t *acc, uint64_t *t1, uint64_t *t2, size_t n,
+                      size_t r, unsigned int erode)
+{
+	uint64_t fill = erode ? ~(uint64_t)0 : 0;
+	for (size_t cover = 0; cover < r; ) {
+		size_t step = cover + 1 < r - cover ? cover + 1 : r - cover;
+		bitset_morph_shl(t1, acc, n, step, fill);
+		bitset_morph_shr(t2, acc, n, step, fill);
+		if (erode)
+			for (size_t i = 0; i < n; ++i)
+				acc[i] &= t1[i] & t2[i];
+		else
+			for (size_t i = 0; i < n; ++i)
+				acc[i] |= t1[i] | t2[i];
+		cover += step;
+	}
+}
+
+/* loads a row, setting the bits beyond the width to the identity of
+ | the operation so that they never influence pixels inside */
+static
+void bitset_morph_load(uint64_t *dst, struct bitset *row, size_t n,
+                       size_t width, unsigned int erode)
+{
+	for (size_t i = 0; i < n; ++i)
+		dst[i] = bitset_word(row, i);
+	if (width & 0x3f) {
+		uint64_t beyond = ~(uint64_t)0 << (width & 0x3f);
+		dst[n - 1] = erode ? dst[n - 1] | beyond : dst[n - 1] & ~beyond;
+	}
+}
+
+static
+void *bitset_morph_band(void *arg)
+{
+	struct bitset_morph_job *job = arg;
+	size_t n = bitset_internal_words(job->width);
+	size_t ry = job->ry;
+	size_t w = 2 * ry + 1;
+	size_t rows = job->y1 - job->y0;
+	/* virtual rows y0 - ry to y1 + ry - 1, outside the image the
+	 | identity of the operation */
+	size_t span = rows + 2 * ry;
+	uint64_t ident = job->erode ? ~(uint64_t)0 : 0;
+
+	uint64_t *vert = malloc(span * n * sizeof(uint64_t));
+	uint64_t *pre = malloc(span * n * sizeof(uint64_t));
+	uint64_t *suf = malloc(span * n * sizeof(uint64_t));
+	uint64_t *t1 = malloc(4 * n * sizeof(uint64_t));
+	job->ok = vert && pre && suf && t1;
+	if (!job->ok)
+		goto done;
+	uint64_t *t2 = t1 + n, *out = t2 + n, *center = out + n;
+
+	for (size_t v = 0; v < span; ++v) {
+		uint64_t *row = vert + v * n;
+		size_t y = job->y0 + v - ry;
+		if (job->y0 + v < ry || y >= job->height) {
+			for (size_t i = 0; i < n; ++i)
+				row[i] = ident;
+			continue;
+		}
+		bitset_morph_load(row, job->src[y], n, job->width, job->erode);
+		if (job->shape == BITSET_MORPH_RECT)
+			bitset_morph_row(row, t1, t2, n, job->rx, job->erode);
+	}
+
+	/* van Herk / Gil-Werman: prefix and suffix combinations within
+	 | blocks of w rows, so each window costs one combination */
+	for (size_t v = 0; v < span; ++v) {
+		uint64_t *p = pre + v * n, *s = vert + v * n;
+		if (v % w)
+			for (size_t i = 0; i < n; ++i)
+				p[i] = job->erode ? p[i - n] & s[i] : p[i - n] | s[i];
+		else
+			memcpy(p, s, n * sizeof(uint64_t));
+	}
+	for (size_t v = span; v--; ) {
+		uint64_t *q = suf + v * n, *s = vert + v * n;
+		if ((v + 1) % w && v + 1 < span)
+			for (size_t i = 0; i < n; ++i)
+				q[i] = job->erode ? q[i + n] & s[i] : q[i + n] | s[i];
+		else
+			memcpy(q, s, n * sizeof(uint64_t));
+	}
+
+	for (size_t r = 0; r < rows; ++r) {
+		const uint64_t *a = suf + r * n, *b = pre + (r + w - 1) * n;
+		size_t y = job->y0 + r;
+		for (size_t i = 0; i < n; ++i)
+			out[i] = job->erode ? a[i] & b[i] : a[i] | b[i];
+		if (job->shape == BITSET_MORPH_CROSS) {
+			/* the horizontal bar through the center */
+			bitset_morph_load(center, job->src[y], n, job->width, job->erode);
+			bitset_morph_row(center, t1, t2, n, job->rx, job->erode);
+			for (size_t i = 0; i < n; ++i)
+				out[i] = job->erode ? out[i] & center[i] : out[i] | center[i];
+		}
+		/* bits of the last byte at or beyond the width are kept */
+		size_t bytes = bitset_internal_bytes(job->width);
+		unsigned char *last = job->dst[y]->data + bytes - 1;
+		unsigned char keep = ~0U << (job->width & 0x7);
+		unsigned char old = *last;
+		for (size_t i = 0; i < n; ++i)
+			bitset_internal_store(job->dst[y]->data + (i << 3), out[i],
+			                      i + 1 < n ? 8 : bytes - (i << 3));
+		if (job->width & 0x7)
+			*last = (old & keep) | (*last & ~keep);
+	}
+
+done:
+	free(vert);
+	free(pre);
+	free(suf);
+	free(t1);
+	return NULL;
+}
+
+static
+int bitset_morph_apply(struct bitset **dst, struct bitset **src,
+                       size_t height, size_t width, size_t rx, size_t ry,
+                       unsigned int shape, unsigned int threads,
+                       unsigned int erode)
+{
+	if (!height || !width)
+		return 1;
+	if (!threads)
+		threads = 1;
+	if (threads > BITSET_MORPH_MAX_THREADS)
+		threads = BITSET_MORPH_MAX_THREADS;
+	if (threads > height)
+		threads = height;
+
+	struct bitset_morph_job jobs[threads];
+	for (unsigned int t = 0; t < threads; ++t) {
+		struct bitset_morph_job job = {
+			dst, src, height, width, rx, ry, shape, erode,
+			height * t / threads, height * (t + 1) / threads, 0, NULL, 0
+		};
+		jobs[t] = job;
+	}
+	bitset_morph_run_jobs(bitset_morph_band, jobs, threads);
+
+	for (unsigned int t = 0; t < threads; ++t)
+		if (!jobs[t].ok)
+			return 0;
+	for (size_t y = 0; y < height; ++y)
+		bitset_recount(dst[y]);
+	return 1;
+}
+
+/* bitset_morph_dilate(dst, src, height, width, rx, ry, shape, threads)
+ |   dilates a binary image stored as rows of bitsets: a pixel is set
+ |   if any pixel under the structuring element centered on it is set;
+ |   pixels outside the image count as cleared. Rows are combined
+ |   word-wide, horizontally by shifting with doubling radius and
+ |   vertically with prefix/suffix blocks, in parallel over row bands;
+ |   returns 1 on success, 0 if memory could not be allocated
+ | dst:     height rows of at least width bits, distinct from src
+ | src:     height rows of at least width bits
+ | height:  number of rows
+ | width:   number of pixels per row
+ | rx:      horizontal radius of the structuring element
+ | ry:      vertical radius of the structuring element
+ | shape:   BITSET_MORPH_RECT or BITSET_MORPH_CROSS
+ | threads: number of threads, 0 or 1 for none, at most
+ |          BITSET_MORPH_MAX_THREADS
+ */
+int bitset_morph_dilate(struct bitset **dst, struct bitset **src,
+                        size_t height, size_t width, size_t rx, size_t ry,
+                        unsigned int shape, unsigned int threads)
+{
+	return bitset_morph_apply(dst, src, height, width, rx, ry,
+	                          shape, threads, 0);
+}
+
+/* bitset_morph_erode(dst, src, height, width, rx, ry, shape, threads)
+ |   erodes a binary image stored as rows of bitsets: a pixel is set if
+ |   all pixels under the structuring element centered on it are set;
+ |   pixels outside the image count as set, so the border of the image
+ |   does not erode. Parameters as for bitset_morph_dilate;
+ |   returns 1 on success, 0 if memory could not be allocated
+ */
+int bitset_morph_erode(struct bitset **dst, struct bitset **src,
+                       size_t height, size_t width, size_t rx, size_t ry,
+                       unsigned int shape, unsigned int threads)
+{
+	return bitset_morph_apply(dst, src, height, width, rx, ry,
+	                          shape, threads, 1);
+}
+
+/* extracts the runs of a band of rows, skipping whole words */
+static
+void *bitset_morph_runs(void *arg)
+{
+	struct bitset_morph_job *job = arg;
+	size_t capacity = 0;
+	size_t words = bitset_internal_words(job->width);
+	job->ok = 1;
+
+	for (size_t y = job->y0; y < job->y1; ++y) {
+		struct bitset *row = job->src[y];
+		size_t w = 0;
+		uint64_t word = bitset_word(row, 0);
+		for (;;) {
+			while (!word && ++w < words)
+				word = bitset_word(row, w);
+			if (!word)
+				break;
+			size_t begin = (w << 6) + bitset_internal_ctz(word);
+			if (begin >= job->width)
+				break;
+			/* clear everything below the run's end */
+			uint64_t rest = ~word & (~(uint64_t)0 << (begin & 0x3f));
+			while (!rest && ++w < words)
+				rest = ~bitset_word(row, w);
+			size_t end = rest ? (w << 6) + bitset_internal_ctz(rest) : words << 6;
+			if (end > job->width)
+				end = job->width;
+
+			if (job->num == capacity) {
+				capacity = capacity ? capacity * 2 : 256;
+				struct bitset_morph_run *runs =
+					realloc(job->runs, capacity * sizeof(*runs));
+				if (!runs) {
+					job->ok = 0;
+					return NULL;
+				}
+				job->runs = runs;
+			}
+			struct bitset_morph_run run = { y, begin, end, 0 };
+			job->runs[job->num++] = run;
+
+			if (end >= job->width)
+				break;
+			w = end >> 6;
+			word = bitset_word(row, w) & (~(uint64_t)0 << (end & 0x3f));
+		}
+	}
+	return NULL;
+}
+
+static inline
+size_t bitset_morph_find(size_t *parent, size_t x)
+{
+	while (parent[x] != x)
+		x = parent[x] = parent[parent[x]];
+	return x;
+}
+
+static inline
+void bitset_morph_union(size_t *parent, size_t a, size_t b)
+{
+	a = bitset_morph_find(parent, a);
+	b = bitset_morph_find(parent, b);
+	if (a < b)
+		parent[b] = a;
+	else
+		parent[a] = b;
+}
+
+/* bitset_morph_label(rows, height, width, diagonal, threads, runs, num)
+ |   labels the connected components of a binary image: the runs of
+ |   set pixels are extracted in parallel over row bands, and runs of
+ |   neighbouring rows that touch are merged with union-find;
+ |   returns the number of components, labelled 0 to (count - 1) in
+ |   the order in which they are first met scanning row by row,
+ |   or SIZE_MAX if memory could not be allocated
+ | rows:     height rows of at least width bits
+ | height:   number of rows
+ | width:    number of pixels per row
+ | diagonal: boolean, whether diagonal neighbours are connected
+ | threads:  number of threads for run extraction, 0 or 1 for none,
+ |             at most BITSET_MORPH_MAX_THREADS
+ | runs:     receives an array of all runs in row order, with labels;
+ |             to be released with free
+ | num:      receives the number of runs
+ */
+size_t bitset_morph_label(struct bitset **rows, size_t height, size_t width,
+                          unsigned int diagonal, unsigned int threads,
+                          struct bitset_morph_run **runs, size_t *num)
+{
+	*runs = NULL;
+	*num = 0;
+	if (!height || !width)
+		return 0;
+	if (!threads)
+		threads = 1;
+	if (threads > BITSET_MORPH_MAX_THREADS)
+		threads = BITSET_MORPH_MAX_THREADS;
+	if (threads > height)
+		threads = height;
+
+	struct bitset_morph_job jobs[threads];
+	for (unsigned int t = 0; t < threads; ++t) {
+		struct bitset_morph_job job = {
+			NULL, rows, height, width, 0, 0, 0, 0,
+			height * t / threads, height * (t + 1) / threads, 0, NULL, 0
+		};
+		jobs[t] = job;
+	}
+	bitset_morph_run_jobs(bitset_morph_runs, jobs, threads);
+
+	size_t total = 0;
+	int ok = 1;
+	for (unsigned int t = 0; t < threads; ++t) {
+		total += jobs[t].num;
+		ok &= jobs[t].ok;
+	}
+	struct bitset_morph_run *all = ok ? malloc((total + 1) * sizeof(*all)) : NULL;
+	size_t *parent = all ? malloc((total + 1) * sizeof(size_t)) : NULL;
+	if (parent) {
+		size_t at = 0;
+		for (unsigned int t = 0; t < threads; ++t) {
+			memcpy(all + at, jobs[t].runs, jobs[t].num * sizeof(*all));
+			at += jobs[t].num;
+		}
+	}
+	for (unsigned int t = 0; t < threads; ++t)
+		free(jobs[t].runs);
+	if (!parent) {
+		free(all);
+		return SIZE_MAX;
+	}
+
+	/* merge touching runs of consecutive rows with two cursors */
+	size_t d = !!diagonal;
+	size_t prev = 0, cur = 0;
+	for (size_t i = 0; i < total; ++i)
+		parent[i] = i;
+	while (cur < total) {
+		size_t row = all[cur].row;
+		size_t next = cur;
+		while (next < total && all[next].row == row)
+			++next;
+		while (prev < cur && all[prev].row + 1 < row)
+			++prev;
+
+		size_t i = prev, j = cur;
+		while (i < cur && j < next) {
+			if (all[i].end + d <= all[j].begin)
+				++i;
+			else if (all[j].end + d <= all[i].begin)
+				++j;
+			else {
+				bitset_morph_union(parent, i, j);
+				if (all[i].end < all[j].end)
+					++i;
+				else
+					++j;
+			}
+		}
+		prev = cur;
+		cur = next;
+	}
+
+	/* roots are the earliest run of their component */
+	size_t count = 0;
+	for (size_t i = 0; i < total; ++i) {
+		size_t root = bitset_morph_find(parent, i);
+		all[i].label = root == i ? count++ : all[root].label;
+	}
+
+	free(parent);
+	*runs = all;
+	*num = total;
+	return count;
+}
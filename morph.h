@@ -0,0 +1,49 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef BITSET_MORPH_H
+#define BITSET_MORPH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitset.h"
+
+/* structuring elements: a (2 rx + 1) x (2 ry + 1) rectangle, or the
+ | horizontal and vertical bar of that rectangle through its center */
+#define BITSET_MORPH_RECT  0
+#define BITSET_MORPH_CROSS 1
+
+/* upper bound on the threads of one call; larger requests are capped */
+#define BITSET_MORPH_MAX_THREADS 256
+
+/* a horizontal run of set pixels: begin to (end - 1) of a row */
+struct bitset_morph_run {
+	size_t row;
+	size_t begin;
+	size_t end;
+	size_t label;
+};
+
+int bitset_morph_dilate(struct bitset **dst, struct bitset **src,
+                        size_t height, size_t width, size_t rx, size_t ry,
+                        unsigned int shape, unsigned int threads);
+int bitset_morph_erode(struct bitset **dst, struct bitset **src,
+                       size_t height, size_t width, size_t rx, size_t ry,
+                       unsigned int shape, unsigned int threads);
+size_t bitset_morph_label(struct bitset **rows, size_t height, size_t width,
+                          unsigned int diagonal, unsigned int threads,
+                          struct bitset_morph_run **runs, size_t *num);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BITSET_MORPH_H */
@@ -0,0 +1,261 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#define _GNU_SOURCE
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#include "bitset.h"
+#include "numa.h"
+#include "internal.c"
+
+/* values of the kernel interface, to not depend on libnuma headers */
+#define BITSET_NUMA_MPOL_BIND       2
+#define BITSET_NUMA_MPOL_INTERLEAVE 3
+#define BITSET_NUMA_MPOL_MF_MOVE    (1 << 1)
+
+#if defined(__linux__) && defined(SYS_mbind)
+#define BITSET_NUMA_SYSCALLS 1
+#endif
+
+/* reads a node list like "0-1,4" into a mask; returns 0 on failure */
+static
+uint64_t bitset_numa_read_mask(const char *path)
+{
+	FILE *file = fopen(path, "r");
+	if (!file)
+		return 0;
+
+	uint64_t mask = 0;
+	unsigned int first, last;
+	int n;
+	while ((n = fscanf(file, "%u", &first)) == 1) {
+		last = first;
+		int c = fgetc(file);
+		if (c == '-') {
+			if (fscanf(file, "%u", &last) != 1)
+				break;
+			c = fgetc(file);
+		}
+		for (unsigned int i = first; i <= last && i < BITSET_NUMA_MAX_NODES; ++i)
+			mask |= (uint64_t)1 << i;
+		if (c != ',')
+			break;
+	}
+	fclose(file);
+	return mask;
+}
+
+/* bitset_numa_nodes(nodes)
+ |   finds the nodes that have memory;
+ |   returns their number, 1 on machines without NUMA information
+ | nodes: pointer to memory for BITSET_NUMA_MAX_NODES node numbers,
+ |        or NULL
+ */
+unsigned int bitset_numa_nodes(unsigned int *nodes)
+{
+	uint64_t mask = bitset_numa_read_mask("/sys/devices/system/node/has_memory");
+	if (!mask)
+		mask = bitset_numa_read_mask("/sys/devices/system/node/online");
+	if (!mask)
+		mask = 1;
+
+	unsigned int num = 0;
+	for (; mask; mask &= mask - 1, ++num)
+		if (nodes)
+			nodes[num] = bitset_internal_ctz(mask);
+	return num;
+}
+
+/* bitset_numa_node()
+ |   returns the node of the processor the calling thread runs on, or 0
+ |   if it cannot be determined
+ */
+unsigned int bitset_numa_node(void)
+{
+#if defined(BITSET_NUMA_SYSCALLS) && defined(SYS_getcpu)
+	unsigned int cpu, node;
+	if (!syscall(SYS_getcpu, &cpu, &node, NULL))
+		return node;
+#endif
+	return 0;
+}
+
+/* applies a memory policy to whole pages; failures leave the default
+ | policy, the memory is usable either way */
+static
+void bitset_numa_place(void *data, size_t bytes, unsigned int policy,
+                       unsigned int node)
+{
+#if defined(BITSET_NUMA_SYSCALLS)
+	unsigned int nodes[BITSET_NUMA_MAX_NODES];
+	unsigned int num = bitset_numa_nodes(nodes);
+	if (num < 2 || policy == BITSET_NUMA_LOCAL)
+		return;
+
+	unsigned long mask[BITSET_NUMA_MAX_NODES / (8 * sizeof(unsigned long))];
+	memset(mask, 0, sizeof(mask));
+	int mode;
+	if (policy == BITSET_NUMA_BIND) {
+		if (node >= BITSET_NUMA_MAX_NODES)
+			return;
+		mask[node / (8 * sizeof(unsigned long))] |=
+			1UL << (node % (8 * sizeof(unsigned long)));
+		mode = BITSET_NUMA_MPOL_BIND;
+	} else {
+		for (unsigned int i = 0; i < num; ++i)
+			mask[nodes[i] / (8 * sizeof(unsigned long))] |=
+				1UL << (nodes[i] % (8 * sizeof(unsigned long)));
+		mode = BITSET_NUMA_MPOL_INTERLEAVE;
+	}
+	/* maxnode counts one more than the kernel looks at */
+	syscall(SYS_mbind, data, bytes, mode, mask,
+	        (unsigned long)BITSET_NUMA_MAX_NODES + 1,
+	        (unsigned int)BITSET_NUMA_MPOL_MF_MOVE);
+#else
+	(void)data;
+	(void)bytes;
+	(void)policy;
+	(void)node;
+#endif
+}
+
+/* bitset_numa_malloc(num, policy, node)
+ |   creates a cleared [struct bitset] whose memory is page-aligned and
+ |   placed by the policy before it is first touched; on a single node,
+ |   or without the system calls, this is an ordinary bitset_calloc.
+ |   bitset_resize moves the data to memory with the default policy;
+ |   returns a pointer to the allocated struct
+ | num:    number of bits the bitset should be able hold
+ | policy: BITSET_NUMA_LOCAL, BITSET_NUMA_INTERLEAVE or BITSET_NUMA_BIND
+ | node:   node to bind to, for BITSET_NUMA_BIND
+ */
+struct bitset *bitset_numa_malloc(size_t num, unsigned int policy,
+                                  unsigned int node)
+{
+	struct bitset *set = calloc(1, sizeof(struct bitset));
+	if (!set)
+		return NULL;
+
+	long page = sysconf(_SC_PAGESIZE);
+	if (page <= 0)
+		page = 4096;
+	size_t bytes = bitset_internal_bytes(num ? num : 1);
+	bytes = (bytes + page - 1) / page * page;
+	void *data;
+	if (posix_memalign(&data, page, bytes)) {
+		free(set);
+		return NULL;
+	}
+
+	bitset_numa_place(data, bytes, policy, node);
+	memset(data, 0, bytes);
+	set->data = data;
+	set->capacity = bitset_internal_capacity(bytes);
+	set->size = num;
+	return set;
+}
+
+/* bitset_numa_replicate(set)
+ |   creates one copy of the bitset bound to every node with memory,
+ |   a single unbound copy on machines with one node;
+ |   returns a pointer to the allocated struct
+ | set: valid pointer to a [struct bitset]
+ */
+struct bitset_numa_replicas *bitset_numa_replicate(struct bitset *set)
+{
+	struct bitset_numa_replicas *rep =
+		calloc(1, sizeof(struct bitset_numa_replicas));
+	if (!rep)
+		return NULL;
+
+	unsigned int num = bitset_numa_nodes(rep->nodes);
+	unsigned int policy = num > 1 ? BITSET_NUMA_BIND : BITSET_NUMA_LOCAL;
+	size_t bytes = set->size ? bitset_internal_bytes(set->size) : 0;
+	for (; rep->num < num; ++rep->num) {
+		struct bitset *copy = bitset_numa_malloc(set->size, policy,
+		                                         rep->nodes[rep->num]);
+		if (!copy) {
+			bitset_numa_replicas_free(rep);
+			return NULL;
+		}
+		memcpy(copy->data, set->data, bytes);
+		rep->copies[rep->num] = copy;
+	}
+	return rep;
+}
+
+/* bitset_numa_replicas_free(rep)
+ |   frees all copies
+ | rep: pointer to a [struct bitset_numa_replicas]
+ */
+void bitset_numa_replicas_free(struct bitset_numa_replicas *rep)
+{
+	for (size_t i = 0; i < rep->num; ++i)
+		bitset_free(rep->copies[i]);
+	free(rep);
+}
+
+/* bitset_numa_local(rep)
+ |   returns the copy on the node the calling thread runs on, for reads
+ |   only; the first copy if that node has none
+ | rep: valid pointer to a [struct bitset_numa_replicas]
+ */
+struct bitset *bitset_numa_local(struct bitset_numa_replicas *rep)
+{
+	if (rep->num == 1)
+		return rep->copies[0];
+	unsigned int node = bitset_numa_node();
+	for (size_t i = 0; i < rep->num; ++i)
+		if (rep->nodes[i] == node)
+			return rep->copies[i];
+	return rep->copies[0];
+}
+
+/* bitset_numa_set(rep, index, state)
+ |   sets a bit to the specified state in every copy
+ | rep:   valid pointer to a [struct bitset_numa_replicas]
+ | index: the offset of the bit in the bitset
+ | state: a boolean value expressing the specified bit's new state
+ */
+void bitset_numa_set(struct bitset_numa_replicas *rep, size_t index,
+                     unsigned int state)
+{
+	for (size_t i = 0; i < rep->num; ++i)
+		bitset_set(rep->copies[i], index, state);
+}
+
+/* bitset_numa_rset(rep, begin, end)
+ |   sets the bits begin to (end - 1) in every copy;
+ |   returns the number of bits set
+ */
+size_t bitset_numa_rset(struct bitset_numa_replicas *rep, size_t begin,
+                        size_t end)
+{
+	for (size_t i = 0; i < rep->num; ++i)
+		bitset_rset(rep->copies[i], begin, end);
+	return begin < end ? end - begin : 0;
+}
+
+/* bitset_numa_rclear(rep, begin, end)
+ |   clears the bits begin to (end - 1) in every copy;
+ |   returns the number of bits cleared
+ */
+size_t bitset_numa_rclear(struct bitset_numa_replicas *rep, size_t begin,
+                          size_t end)
+{
+	for (size_t i = 0; i < rep->num; ++i)
+		bitset_rclear(rep->copies[i], begin, end);
+	return begin < end ? end - begin : 0;
+}
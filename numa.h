@@ -0,0 +1,54 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef BITSET_NUMA_H
+#define BITSET_NUMA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitset.h"
+
+/* placement policies for bitset_numa_malloc */
+#define BITSET_NUMA_LOCAL      0 /* pages go to the node that touches them */
+#define BITSET_NUMA_INTERLEAVE 1 /* pages alternate over all nodes */
+#define BITSET_NUMA_BIND       2 /* pages only come from one node */
+
+/* highest number of nodes that is handled, one bit of a node mask each */
+#define BITSET_NUMA_MAX_NODES 64
+
+/* one copy of a bitset per node with memory; reads use the copy of the
+ | node the thread runs on, writes go to all of them */
+struct bitset_numa_replicas {
+	size_t num;
+	unsigned int nodes[BITSET_NUMA_MAX_NODES];
+	struct bitset *copies[BITSET_NUMA_MAX_NODES];
+};
+
+unsigned int bitset_numa_nodes(unsigned int *nodes);
+unsigned int bitset_numa_node(void);
+struct bitset *bitset_numa_malloc(size_t num, unsigned int policy,
+                                  unsigned int node);
+
+struct bitset_numa_replicas *bitset_numa_replicate(struct bitset *set);
+void bitset_numa_replicas_free(struct bitset_numa_replicas *rep);
+struct bitset *bitset_numa_local(struct bitset_numa_replicas *rep);
+void bitset_numa_set(struct bitset_numa_replicas *rep, size_t index,
+                     unsigned int state);
+size_t bitset_numa_rset(struct bitset_numa_replicas *rep, size_t begin,
+                        size_t end);
+size_t bitset_numa_rclear(struct bitset_numa_replicas *rep, size_t begin,
+                          size_t end);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BITSET_NUMA_H */
@@ -0,0 +1,219 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset.h"
+#include "paged.h"
+#include "internal.c"
+
+#define BITSET_PAGED_WORDS (BITSET_PAGED_BYTES / 8)
+
+/* shared by all pages that were never written; const, so writing to it
+ | by mistake faults instead of setting bits in every empty page */
+static const unsigned char bitset_paged_zero[BITSET_PAGED_BYTES];
+
+#define bitset_paged_is_zero(page) \
+	((const unsigned char *)(page) == bitset_paged_zero)
+
+static inline
+uint64_t bitset_paged_word(const unsigned char *page, size_t w)
+{
+	return bitset_internal_load(page + (w << 3), 8);
+}
+
+/* bitset_paged_new(size)
+ |   creates a cleared paged bitset; only the page table is allocated,
+ |   8 bytes per BITSET_PAGED_BYTES of bits;
+ |   returns a pointer to the allocated struct
+ | size: number of bits
+ */
+struct bitset_paged *bitset_paged_new(size_t size)
+{
+	struct bitset_paged *paged = calloc(1, sizeof(struct bitset_paged));
+	if (!paged)
+		return NULL;
+	paged->size = size;
+	paged->pages = (size >> BITSET_PAGED_SHIFT) +
+	               !!(size & ((1 << BITSET_PAGED_SHIFT) - 1));
+	paged->table = malloc((paged->pages ? paged->pages : 1) *
+	                      sizeof(unsigned char *));
+	if (!paged->table) {
+		free(paged);
+		return NULL;
+	}
+	for (size_t i = 0; i < paged->pages; ++i)
+		paged->table[i] = (unsigned char *)bitset_paged_zero;
+	return paged;
+}
+
+/* bitset_paged_free(paged)
+ |   frees memory associated with the given paged bitset
+ | paged: pointer to a [struct bitset_paged]
+ */
+void bitset_paged_free(struct bitset_paged *paged)
+{
+	for (size_t i = 0; i < paged->pages; ++i)
+		if (!bitset_paged_is_zero(paged->table[i]))
+			free(paged->table[i]);
+	free(paged->table);
+	free(paged);
+}
+
+/* bitset_paged_set(paged, index, state)
+ |   sets a bit to the specified state, allocating its page when a bit
+ |   of a zero page is set;
+ |   returns 1 on success, 0 if memory could not be allocated
+ | paged: valid pointer to a [struct bitset_paged]
+ | index: the offset of the bit
+ | state: a boolean value expressing the bit's new state
+ */
+int bitset_paged_set(struct bitset_paged *paged, size_t index,
+                     unsigned int state)
+{
+	unsigned char **slot = paged->table + (index >> BITSET_PAGED_SHIFT);
+	if (bitset_paged_is_zero(*slot)) {
+		if (!state)
+			return 1;
+		unsigned char *page = calloc(1, BITSET_PAGED_BYTES);
+		if (!page)
+			return 0;
+		*slot = page;
+		++paged->allocated;
+	}
+
+	unsigned char *entry = *slot + ((index >> 3) & (BITSET_PAGED_BYTES - 1));
+	*entry ^= (-!!state ^ *entry) & (1 << (index & 0x7));
+	return 1;
+}
+
+/* bitset_paged_count(paged)
+ |   returns the number of set bits, reading allocated pages only
+ | paged: valid pointer to a [struct bitset_paged]
+ */
+size_t bitset_paged_count(struct bitset_paged *paged)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < paged->pages; ++i) {
+		const unsigned char *page = paged->table[i];
+		if (bitset_paged_is_zero(page))
+			continue;
+		for (size_t w = 0; w < BITSET_PAGED_WORDS; ++w)
+			count += bitset_internal_popcount(bitset_paged_word(page, w));
+	}
+	return count;
+}
+
+/* bitset_paged_next(paged, index)
+ |   returns the index of the first set bit at or after index, or
+ |   SIZE_MAX if there is none; zero pages are skipped as a whole
+ | paged: valid pointer to a [struct bitset_paged]
+ | index: position to start searching from
+ */
+size_t bitset_paged_next(struct bitset_paged *paged, size_t index)
+{
+	if (index >= paged->size)
+		return SIZE_MAX;
+
+	size_t i = index >> BITSET_PAGED_SHIFT;
+	size_t w = (index >> 6) & (BITSET_PAGED_WORDS - 1);
+	uint64_t mask = ~(uint64_t)0 << (index & 0x3f);
+	for (; i < paged->pages; ++i, w = 0, mask = ~(uint64_t)0) {
+		const unsigned char *page = paged->table[i];
+		if (bitset_paged_is_zero(page))
+			continue;
+		for (; w < BITSET_PAGED_WORDS; ++w, mask = ~(uint64_t)0) {
+			uint64_t word = bitset_paged_word(page, w) & mask;
+			if (word) {
+				size_t bit = ((i << BITSET_PAGED_SHIFT) | (w << 6)) +
+				             bitset_internal_ctz(word);
+				return bit < paged->size ? bit : SIZE_MAX;
+			}
+		}
+	}
+	return SIZE_MAX;
+}
+
+/* bitset_paged_or(dst, src)
+ |   sets every bit of dst that is set in src; zero pages of src are
+ |   skipped and pages of dst that are still zero receive a copy;
+ |   returns 1 on success, 0 if memory could not be allocated (the
+ |   pages done so far are kept)
+ | dst: valid pointer to a [struct bitset_paged]
+ | src: valid pointer to a [struct bitset_paged] of the same size
+ */
+int bitset_paged_or(struct bitset_paged *dst, struct bitset_paged *src)
+{
+	for (size_t i = 0; i < dst->pages; ++i) {
+		const unsigned char *from = src->table[i];
+		if (bitset_paged_is_zero(from) || from == dst->table[i])
+			continue;
+		if (bitset_paged_is_zero(dst->table[i])) {
+			unsigned char *page = malloc(BITSET_PAGED_BYTES);
+			if (!page)
+				return 0;
+			memcpy(page, from, BITSET_PAGED_BYTES);
+			dst->table[i] = page;
+			++dst->allocated;
+			continue;
+		}
+		unsigned char *to = dst->table[i];
+		for (size_t w = 0; w < BITSET_PAGED_WORDS; ++w)
+			bitset_internal_store(to + (w << 3), bitset_paged_word(to, w) |
+			                      bitset_paged_word(from, w), 8);
+	}
+	return 1;
+}
+
+/* bitset_paged_and(dst, src)
+ |   clears every bit of dst that is cleared in src; pages of dst whose
+ |   page in src is zero are released without being read
+ | dst: valid pointer to a [struct bitset_paged]
+ | src: valid pointer to a [struct bitset_paged] of the same size
+ */
+void bitset_paged_and(struct bitset_paged *dst, struct bitset_paged *src)
+{
+	for (size_t i = 0; i < dst->pages; ++i) {
+		unsigned char *to = dst->table[i];
+		const unsigned char *from = src->table[i];
+		if (bitset_paged_is_zero(to) || from == to)
+			continue;
+		if (bitset_paged_is_zero(from)) {
+			free(to);
+			dst->table[i] = (unsigned char *)bitset_paged_zero;
+			--dst->allocated;
+			continue;
+		}
+		for (size_t w = 0; w < BITSET_PAGED_WORDS; ++w)
+			bitset_internal_store(to + (w << 3), bitset_paged_word(to, w) &
+			                      bitset_paged_word(from, w), 8);
+	}
+}
+
+/* bitset_paged_trim(paged)
+ |   releases allocated pages that have become all zero, so that they
+ |   are skipped again by bulk operations;
+ |   returns the number of pages released
+ | paged: valid pointer to a [struct bitset_paged]
+ */
+size_t bitset_paged_trim(struct bitset_paged *paged)
+{
+	size_t released = 0;
+	for (size_t i = 0; i < paged->pages; ++i) {
+		unsigned char *page = paged->table[i];
+		if (bitset_paged_is_zero(page) ||
+		    memcmp(page, bitset_paged_zero, BITSET_PAGED_BYTES))
+			continue;
+		free(page);
+		paged->table[i] = (unsigned char *)bitset_paged_zero;
+		++released;
+	}
+	paged->allocated -= released;
+	return released;
+}
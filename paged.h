@@ -0,0 +1,61 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef BITSET_PAGED_H
+#define BITSET_PAGED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitset.h"
+
+/* bytes per page and the number of bits a page holds as a shift */
+#define BITSET_PAGED_BYTES 4096
+#define BITSET_PAGED_SHIFT 15
+
+/* bitset whose pages are allocated on their first write; every entry
+ | of the table points either to an allocated page or to one shared,
+ | read-only page of zeroes */
+struct bitset_paged {
+	size_t size;
+	size_t pages;
+	size_t allocated;
+	unsigned char **table;
+};
+
+struct bitset_paged *bitset_paged_new(size_t size);
+void bitset_paged_free(struct bitset_paged *paged);
+
+int bitset_paged_set(struct bitset_paged *paged, size_t index,
+                     unsigned int state);
+size_t bitset_paged_count(struct bitset_paged *paged);
+size_t bitset_paged_next(struct bitset_paged *paged, size_t index);
+int bitset_paged_or(struct bitset_paged *dst, struct bitset_paged *src);
+void bitset_paged_and(struct bitset_paged *dst, struct bitset_paged *src);
+size_t bitset_paged_trim(struct bitset_paged *paged);
+
+/* bitset_paged_get(paged, index)
+ |   gets the state of a bit; pages that were never written read the
+ |   zero page, so there is no branch on whether a page exists
+ | paged: valid pointer to a [struct bitset_paged]
+ | index: the offset of the bit
+ */
+static inline
+unsigned int bitset_paged_get(struct bitset_paged *paged, size_t index)
+{
+	const unsigned char *page = paged->table[index >> BITSET_PAGED_SHIFT];
+	return page[(index >> 3) & (BITSET_PAGED_BYTES - 1)] >> (index & 0x7) & 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BITSET_PAGED_H */
@@ -0,0 +1,223 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset.h"
+#include "permute.h"
+#include "internal.c"
+
+/* indices handled per chunk; the chunk's own bits stay in L1 */
+#define BITSET_PERMUTE_CHUNK (1 << 18)
+/* log2 of the bits of the other side covered by one partition;
+ | 2^18 bits are 32 KiB, so the random accesses of a partition stay
+ | within L2 */
+#define BITSET_PERMUTE_SHIFT 18
+
+struct bitset_permute_job {
+	struct bitset *src;
+	struct bitset *dst;
+	const size_t *perm;
+	size_t num;
+	unsigned int first;
+	unsigned int step;
+	unsigned int inverse;
+	unsigned int atomic;
+	int ok;
+};
+
+static inline
+void bitset_permute_or(unsigned char *byte, unsigned char bits,
+                       unsigned int atomic)
+{
+#if defined(__GNUC__)
+	if (atomic) {
+		__atomic_fetch_or(byte, bits, __ATOMIC_RELAXED);
+		return;
+	}
+#endif
+	(void)atomic;
+	*byte |= bits;
+}
+
+/* processes every step-th chunk starting at first: the chunk's
+ | (offset, target) pairs are partitioned by the target's high bits
+ | with a counting sort, then visited partition by partition so that
+ | the random side is only touched within one cache-sized window */
+static
+void *bitset_permute_worker(void *arg)
+{
+	struct bitset_permute_job *job = arg;
+	size_t other = job->inverse ? job->dst->size : job->src->size;
+	/* a random side that fits in L2 needs no partitioning */
+	size_t buckets = other >> BITSET_PERMUTE_SHIFT > 8
+	               ? (other >> BITSET_PERMUTE_SHIFT) + 1 : 1;
+	size_t *counts = malloc((buckets + 1) * sizeof(size_t));
+	uint64_t *entries = malloc(BITSET_PERMUTE_CHUNK * sizeof(uint64_t));
+	uint64_t *local = malloc(BITSET_PERMUTE_CHUNK / 8);
+	job->ok = counts && entries && local;
+	if (!job->ok)
+		goto done;
+
+	size_t chunks = (job->num + BITSET_PERMUTE_CHUNK - 1) / BITSET_PERMUTE_CHUNK;
+	for (size_t c = job->first; c < chunks; c += job->step) {
+		size_t begin = c * BITSET_PERMUTE_CHUNK;
+		size_t end = begin + BITSET_PERMUTE_CHUNK < job->num
+		           ? begin + BITSET_PERMUTE_CHUNK : job->num;
+		size_t words = bitset_internal_words(end - begin);
+
+		/* an entry holds the target's offset within its partition
+		 | in the upper half and the offset within the chunk in the
+		 | lower half */
+		const uint64_t low = ((uint64_t)1 << BITSET_PERMUTE_SHIFT) - 1;
+		if (buckets > 1) {
+			memset(counts, 0, (buckets + 1) * sizeof(size_t));
+			for (size_t i = begin; i < end; ++i)
+				++counts[(job->perm[i] >> BITSET_PERMUTE_SHIFT) + 1];
+			for (size_t b = 1; b <= buckets; ++b)
+				counts[b] += counts[b - 1];
+			for (size_t i = begin; i < end; ++i) {
+				size_t p = job->perm[i];
+				size_t at = counts[p >> BITSET_PERMUTE_SHIFT]++;
+				entries[at] = (p & low) << 32 | (i - begin);
+			}
+		} else {
+			for (size_t i = begin; i < end; ++i)
+				entries[i - begin] = (uint64_t)job->perm[i] << 32 | (i - begin);
+			counts[0] = end - begin;
+		}
+
+		if (!job->inverse) {
+			/* gather into the chunk, then store it in one go */
+			const unsigned char *src = job->src->data;
+			memset(local, 0, words * sizeof(uint64_t));
+			for (size_t b = 0, k = 0; b < buckets; ++b) {
+				size_t base = b << BITSET_PERMUTE_SHIFT;
+				for (; k < counts[b]; ++k) {
+					size_t p = base + (entries[k] >> 32);
+					uint32_t off = entries[k];
+					uint64_t bit = src[p >> 3] >> (p & 0x7) & 1;
+					local[off >> 6] |= bit << (off & 0x3f);
+				}
+			}
+			size_t bytes = bitset_internal_bytes(end - begin);
+			for (size_t w = 0; w < words; ++w)
+				bitset_internal_store(job->dst->data + (begin >> 3) + (w << 3),
+				                      local[w], w + 1 < words ? 8 : bytes - (w << 3));
+		} else {
+			/* load the chunk, then scatter its set bits */
+			unsigned char *dst = job->dst->data;
+			for (size_t w = 0; w < words; ++w)
+				local[w] = bitset_word(job->src, (begin >> 6) + w);
+			for (size_t b = 0, k = 0; b < buckets; ++b) {
+				size_t base = b << BITSET_PERMUTE_SHIFT;
+				for (; k < counts[b]; ++k) {
+					size_t p = base + (entries[k] >> 32);
+					uint32_t off = entries[k];
+					if (local[off >> 6] >> (off & 0x3f) & 1)
+						bitset_permute_or(dst + (p >> 3), 1 << (p & 0x7),
+						                  job->atomic);
+				}
+			}
+		}
+	}
+
+done:
+	free(counts);
+	free(entries);
+	free(local);
+	return NULL;
+}
+
+static
+int bitset_permute_run(struct bitset *src, const size_t *perm,
+                       struct bitset *dst, unsigned int threads,
+                       unsigned int inverse)
+{
+	size_t num = inverse ? src->size : dst->size;
+	size_t chunks = (num + BITSET_PERMUTE_CHUNK - 1) / BITSET_PERMUTE_CHUNK;
+	if (!num)
+		return 1;
+#if !defined(__GNUC__)
+	/* scattering from several threads needs atomic byte updates */
+	if (inverse)
+		threads = 1;
+#endif
+	if (!threads)
+		threads = 1;
+	if (threads > BITSET_PERMUTE_MAX_THREADS)
+		threads = BITSET_PERMUTE_MAX_THREADS;
+	if (threads > chunks)
+		threads = chunks;
+	if (inverse)
+		bitset_clear(dst);
+
+	struct bitset_permute_job jobs[threads];
+	pthread_t tids[threads];
+	for (unsigned int t = 0; t < threads; ++t) {
+		struct bitset_permute_job job = {
+			src, dst, perm, num, t, threads, inverse, threads > 1, 0
+		};
+		jobs[t] = job;
+	}
+
+	unsigned int started = 1;
+	for (; started < threads; ++started)
+		if (pthread_create(tids + started, NULL, bitset_permute_worker,
+		                   jobs + started))
+			break;
+	bitset_permute_worker(jobs);
+	for (unsigned int t = started; t < threads; ++t)
+		bitset_permute_worker(jobs + t);
+	for (unsigned int t = 1; t < started; ++t)
+		pthread_join(tids[t], NULL);
+
+	for (unsigned int t = 0; t < threads; ++t)
+		if (!jobs[t].ok)
+			return 0;
+	bitset_recount(dst);
+	return 1;
+}
+
+/* bitset_permute(src, perm, dst, threads)
+ |   reorders bits: bit i of dst becomes bit perm[i] of src, for every
+ |   bit of dst. Chunks of dst are processed independently, each
+ |   partitioning its reads by source region first so that both the
+ |   reads and the writes stay cache-resident;
+ |   returns 1 on success, 0 if memory could not be allocated
+ | src:     valid pointer to a [struct bitset]
+ | perm:    dst->size indices into src
+ | dst:     valid pointer to a [struct bitset], distinct from src
+ | threads: number of threads, 0 or 1 for none, at most
+ |          BITSET_PERMUTE_MAX_THREADS
+ */
+int bitset_permute(struct bitset *src, const size_t *perm,
+                   struct bitset *dst, unsigned int threads)
+{
+	return bitset_permute_run(src, perm, dst, threads, 0);
+}
+
+/* bitset_permute_inverse(src, perm, dst, threads)
+ |   reorders bits the other way round: bit perm[i] of dst becomes
+ |   bit i of src, for every bit of src; bits of dst that are not
+ |   targeted are cleared. With several threads the set bits are
+ |   written with atomic byte updates;
+ |   returns 1 on success, 0 if memory could not be allocated
+ | src:     valid pointer to a [struct bitset]
+ | perm:    src->size distinct indices into dst
+ | dst:     valid pointer to a [struct bitset], distinct from src
+ | threads: number of threads, 0 or 1 for none, at most
+ |          BITSET_PERMUTE_MAX_THREADS
+ */
+int bitset_permute_inverse(struct bitset *src, const size_t *perm,
+                           struct bitset *dst, unsigned int threads)
+{
+	return bitset_permute_run(src, perm, dst, threads, 1);
+}
@@ -0,0 +1,31 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef BITSET_PERMUTE_H
+#define BITSET_PERMUTE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitset.h"
+
+/* upper bound on the threads of one call; larger requests are capped */
+#define BITSET_PERMUTE_MAX_THREADS 256
+
+int bitset_permute(struct bitset *src, const size_t *perm,
+                   struct bitset *dst, unsigned int threads);
+int bitset_permute_inverse(struct bitset *src, const size_t *perm,
+                           struct bitset *dst, unsigned int threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BITSET_PERMUTE_H */
@@ -0,0 +1,164 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset.h"
+#include "rank.h"
+#include "internal.c"
+
+#define BITSET_RANK_WORDS (BITSET_RANK_BLOCK / 64)
+
+/* word w of the set, loaded directly when it lies within the size */
+static inline
+uint64_t bitset_rank_word(struct bitset *set, size_t w)
+{
+	if ((w + 1) << 6 <= set->size)
+		return bitset_internal_load(set->data + (w << 3), 8);
+	return bitset_word(set, w);
+}
+
+/* bitset_rank_new(set)
+ |   creates a rank/select directory for the passed set, storing one
+ |   cumulative count per BITSET_RANK_BLOCK bits;
+ |   returns a pointer to the allocated struct
+ | set: valid pointer to a [struct bitset]
+ */
+struct bitset_rank *bitset_rank_new(struct bitset *set)
+{
+	struct bitset_rank *rank = calloc(1, sizeof(struct bitset_rank));
+	if (!rank)
+		return NULL;
+	rank->set = set;
+	if (!bitset_rank_build(rank)) {
+		free(rank);
+		return NULL;
+	}
+	return rank;
+}
+
+/* bitset_rank_free(rank)
+ |   frees memory associated with the given directory, not the bitset
+ | rank: pointer to a [struct bitset_rank]
+ */
+void bitset_rank_free(struct bitset_rank *rank)
+{
+	free(rank->blocks);
+	free(rank);
+}
+
+/* bitset_rank_build(rank)
+ |   recomputes the directory from the current contents of the bitset;
+ |   returns 1 on success, 0 if memory could not be allocated
+ | rank: valid pointer to a [struct bitset_rank]
+ */
+int bitset_rank_build(struct bitset_rank *rank)
+{
+	struct bitset *set = rank->set;
+	size_t num = set->size / BITSET_RANK_BLOCK + 1;
+	if (num != rank->num || !rank->blocks) {
+		uint64_t *blocks = realloc(rank->blocks, (num + 1) * sizeof(uint64_t));
+		if (!blocks)
+			return 0;
+		rank->blocks = blocks;
+		rank->num = num;
+	}
+
+	size_t words = bitset_internal_words(set->size);
+	uint64_t count = 0;
+	for (size_t w = 0; w < words; ++w) {
+		if (!(w % BITSET_RANK_WORDS))
+			rank->blocks[w / BITSET_RANK_WORDS] = count;
+		count += bitset_internal_popcount(bitset_rank_word(set, w));
+	}
+	for (size_t b = (words + BITSET_RANK_WORDS - 1) / BITSET_RANK_WORDS;
+	     b <= num; ++b)
+		rank->blocks[b] = count;
+	return 1;
+}
+
+/* bitset_rank1(rank, index)
+ |   returns the number of set bits before the specified index
+ | rank:  valid pointer to a [struct bitset_rank]
+ | index: position up to which to count (exclusive), at most the size
+ */
+size_t bitset_rank1(struct bitset_rank *rank, size_t index)
+{
+	size_t block = index / BITSET_RANK_BLOCK;
+	size_t count = rank->blocks[block];
+	size_t w = block * BITSET_RANK_WORDS;
+	for (; w < index >> 6; ++w)
+		count += bitset_internal_popcount(bitset_rank_word(rank->set, w));
+	if (index & 0x3f)
+		count += bitset_internal_popcount(bitset_rank_word(rank->set, w) &
+			~(~(uint64_t)0 << (index & 0x3f)));
+	return count;
+}
+
+/* bitset_select1(rank, k)
+ |   returns the position of the set bit preceded by exactly k set bits,
+ |   or SIZE_MAX if there are not enough set bits
+ | rank: valid pointer to a [struct bitset_rank]
+ | k:    number of set bits before the searched one
+ */
+size_t bitset_select1(struct bitset_rank *rank, size_t k)
+{
+	if (k >= rank->blocks[rank->num])
+		return SIZE_MAX;
+
+	/* last block whose cumulative count is <= k */
+	size_t lo = 0, hi = rank->num;
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (rank->blocks[mid] <= k)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	k -= rank->blocks[lo];
+	for (size_t w = lo * BITSET_RANK_WORDS; ; ++w) {
+		uint64_t word = bitset_rank_word(rank->set, w);
+		size_t n = bitset_internal_popcount(word);
+		if (k < n)
+			return (w << 6) + bitset_internal_select(word, k);
+		k -= n;
+	}
+}
+
+/* bitset_select0(rank, k)
+ |   returns the position of the cleared bit preceded by exactly k
+ |   cleared bits, or SIZE_MAX if there are not enough cleared bits
+ | rank: valid pointer to a [struct bitset_rank]
+ | k:    number of cleared bits before the searched one
+ */
+size_t bitset_select0(struct bitset_rank *rank, size_t k)
+{
+	size_t size = rank->set->size;
+	if (k >= size - rank->blocks[rank->num])
+		return SIZE_MAX;
+
+	size_t lo = 0, hi = rank->num;
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (mid * BITSET_RANK_BLOCK - rank->blocks[mid] <= k)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	k -= lo * BITSET_RANK_BLOCK - rank->blocks[lo];
+	for (size_t w = lo * BITSET_RANK_WORDS; ; ++w) {
+		uint64_t word = ~bitset_rank_word(rank->set, w);
+		size_t n = bitset_internal_popcount(word);
+		if (k < n)
+			return (w << 6) + bitset_internal_select(word, k);
+		k -= n;
+	}
+}
@@ -0,0 +1,54 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef BITSET_RANK_H
+#define BITSET_RANK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitset.h"
+
+/* bits covered by one cumulative count */
+#define BITSET_RANK_BLOCK 512
+
+/* static rank/select directory over a bitset; the bitset is referenced,
+ | not copied, and must be rebuilt with bitset_rank_build after it has
+ | been modified */
+struct bitset_rank {
+	struct bitset *set;
+	uint64_t *blocks;
+	size_t num;
+};
+
+struct bitset_rank *bitset_rank_new(struct bitset *set);
+void bitset_rank_free(struct bitset_rank *rank);
+int bitset_rank_build(struct bitset_rank *rank);
+
+size_t bitset_rank1(struct bitset_rank *rank, size_t index);
+size_t bitset_select1(struct bitset_rank *rank, size_t k);
+size_t bitset_select0(struct bitset_rank *rank, size_t k);
+
+/* bitset_rank0(rank, index)
+ |   returns the number of cleared bits before the specified index
+ | rank:  valid pointer to a [struct bitset_rank]
+ | index: position up to which to count (exclusive), at most the size
+ */
+static inline
+size_t bitset_rank0(struct bitset_rank *rank, size_t index)
+{
+	return index - bitset_rank1(rank, index);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BITSET_RANK_H */
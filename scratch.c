@@ -0,0 +1,164 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset.h"
+#include "scratch.h"
+#include "internal.c"
+
+static inline
+uint64_t bitset_scratch_load(struct bitset_scratch *scratch, size_t w)
+{
+	return bitset_internal_load(scratch->set->data + (w << 3), 8);
+}
+
+static inline
+void bitset_scratch_store(struct bitset_scratch *scratch, size_t w,
+                          uint64_t word)
+{
+	bitset_internal_store(scratch->set->data + (w << 3), word, 8);
+}
+
+/* bitset_scratch_new(size, mode)
+ |   creates a cleared scratch bitset of the specified size;
+ |   returns a pointer to the allocated struct
+ | size: number of bits
+ | mode: BITSET_SCRATCH_STAMP, BITSET_SCRATCH_SPARSE or BITSET_SCRATCH_LOG
+ */
+struct bitset_scratch *bitset_scratch_new(size_t size, unsigned int mode)
+{
+	if (!size || mode > BITSET_SCRATCH_LOG)
+		return NULL;
+	struct bitset_scratch *scratch = calloc(1, sizeof(struct bitset_scratch));
+	if (!scratch)
+		return NULL;
+
+	scratch->words = bitset_internal_words(size);
+	scratch->mode = mode;
+	scratch->generation = 1;
+	scratch->set = bitset_calloc(scratch->words << 6);
+	int ok = scratch->set != NULL;
+	if (ok && mode == BITSET_SCRATCH_STAMP) {
+		scratch->stamps = calloc(scratch->words, sizeof(uint32_t));
+		ok = scratch->stamps != NULL;
+	}
+	if (ok && mode != BITSET_SCRATCH_STAMP) {
+		scratch->dense = malloc(scratch->words * sizeof(size_t));
+		ok = scratch->dense != NULL;
+	}
+	if (ok && mode == BITSET_SCRATCH_SPARSE) {
+		/* zeroed once so that lookups never read indeterminate values */
+		scratch->sparse = calloc(scratch->words, sizeof(size_t));
+		ok = scratch->sparse != NULL;
+	}
+	if (!ok) {
+		bitset_scratch_free(scratch);
+		return NULL;
+	}
+	scratch->set->size = size;
+	return scratch;
+}
+
+/* bitset_scratch_free(scratch)
+ |   frees memory associated with the given scratch bitset
+ | scratch: pointer to a [struct bitset_scratch]
+ */
+void bitset_scratch_free(struct bitset_scratch *scratch)
+{
+	if (scratch->set)
+		bitset_free(scratch->set);
+	free(scratch->stamps);
+	free(scratch->dense);
+	free(scratch->sparse);
+	free(scratch);
+}
+
+/* bitset_scratch_set(scratch, index, state)
+ |   sets a bit to the specified state, recording its word as touched
+ | scratch: valid pointer to a [struct bitset_scratch]
+ | index:   the offset of the bit
+ | state:   a boolean value expressing the bit's new state
+ */
+void bitset_scratch_set(struct bitset_scratch *scratch, size_t index,
+                        unsigned int state)
+{
+	size_t w = index >> 6;
+	uint64_t bit = (uint64_t)1 << (index & 0x3f);
+	uint64_t word;
+
+	switch (scratch->mode) {
+	case BITSET_SCRATCH_STAMP:
+		if (scratch->stamps[w] != scratch->generation) {
+			scratch->stamps[w] = scratch->generation;
+			word = 0;
+		} else
+			word = bitset_scratch_load(scratch, w);
+		break;
+	case BITSET_SCRATCH_SPARSE: {
+		size_t at = scratch->sparse[w];
+		if (at >= scratch->touched || scratch->dense[at] != w) {
+			scratch->sparse[w] = scratch->touched;
+			scratch->dense[scratch->touched++] = w;
+		}
+		word = bitset_scratch_load(scratch, w);
+		break;
+	}
+	default:
+		word = bitset_scratch_load(scratch, w);
+		/* a word cleared and set again is logged twice, the log
+		 | overflows to past words and the next reset clears all */
+		if (!word && state && scratch->touched <= scratch->words) {
+			if (scratch->touched < scratch->words)
+				scratch->dense[scratch->touched] = w;
+			++scratch->touched;
+		}
+		break;
+	}
+
+	bitset_scratch_store(scratch, w, state ? word | bit : word & ~bit);
+}
+
+/* bitset_scratch_get(scratch, index)
+ |   gets the state of a bit
+ | scratch: valid pointer to a [struct bitset_scratch]
+ | index:   the offset of the bit
+ */
+unsigned int bitset_scratch_get(struct bitset_scratch *scratch, size_t index)
+{
+	size_t w = index >> 6;
+	if (scratch->mode == BITSET_SCRATCH_STAMP &&
+	    scratch->stamps[w] != scratch->generation)
+		return 0;
+	return bitset_scratch_load(scratch, w) >> (index & 0x3f) & 1;
+}
+
+/* bitset_scratch_reset(scratch)
+ |   clears all bits: STAMP starts a new generation and only clears the
+ |   stamps when the generation counter wraps, SPARSE and LOG clear the
+ |   recorded words
+ | scratch: valid pointer to a [struct bitset_scratch]
+ */
+void bitset_scratch_reset(struct bitset_scratch *scratch)
+{
+	if (scratch->mode == BITSET_SCRATCH_STAMP) {
+		if (!++scratch->generation) {
+			memset(scratch->stamps, 0, scratch->words * sizeof(uint32_t));
+			scratch->generation = 1;
+		}
+		return;
+	}
+
+	if (scratch->touched > scratch->words)
+		memset(scratch->set->data, 0, scratch->words << 3);
+	else
+		for (size_t i = 0; i < scratch->touched; ++i)
+			bitset_scratch_store(scratch, scratch->dense[i], 0);
+	scratch->touched = 0;
+}
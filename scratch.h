@@ -0,0 +1,51 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef BITSET_SCRATCH_H
+#define BITSET_SCRATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitset.h"
+
+/* ways for a scratch bitset to forget its bits on reset */
+#define BITSET_SCRATCH_STAMP  0 /* per-word generation stamps */
+#define BITSET_SCRATCH_SPARSE 1 /* sparse set of touched words */
+#define BITSET_SCRATCH_LOG    2 /* log of words that became non-zero */
+
+/* bitset that is reset in time proportional to the words touched since
+ | the last reset (STAMP: constant time) instead of its size; in SPARSE
+ | and LOG mode set holds the current bits, in STAMP mode a word of set
+ | is only valid if its stamp equals the generation */
+struct bitset_scratch {
+	struct bitset *set;
+	size_t words;
+	unsigned int mode;
+	uint32_t generation;
+	uint32_t *stamps;
+	size_t *dense;
+	size_t *sparse;
+	size_t touched;
+};
+
+struct bitset_scratch *bitset_scratch_new(size_t size, unsigned int mode);
+void bitset_scratch_free(struct bitset_scratch *scratch);
+
+void bitset_scratch_set(struct bitset_scratch *scratch, size_t index,
+                        unsigned int state);
+unsigned int bitset_scratch_get(struct bitset_scratch *scratch, size_t index);
+void bitset_scratch_reset(struct bitset_scratch *scratch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BITSET_SCRATCH_H */
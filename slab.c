@@ -0,0 +1,233 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset.h"
+#include "slab.h"
+#include "internal.c"
+
+/* the free map is allocated in whole words with the slots past the
+ | end marked as used, so words can be accessed without masking */
+static inline
+uint64_t bitset_slab_get(struct bitset *used, size_t w)
+{
+	return bitset_internal_load(used->data + (w << 3), 8);
+}
+
+static inline
+void bitset_slab_put(struct bitset *used, size_t w, uint64_t word)
+{
+	bitset_internal_store(used->data + (w << 3), word, 8);
+}
+
+/* bitset_slab_new(object_size, slots)
+ |   creates an allocator for the specified number of objects of equal
+ |   size; object sizes are rounded up to a multiple of 16 bytes;
+ |   returns a pointer to the allocated struct
+ | object_size: size of every object in bytes
+ | slots:       number of objects that can be allocated at once
+ */
+struct bitset_slab *bitset_slab_new(size_t object_size, size_t slots)
+{
+	if (!object_size || !slots)
+		return NULL;
+	struct bitset_slab *slab = calloc(1, sizeof(struct bitset_slab));
+	if (!slab)
+		return NULL;
+
+	slab->object_size = (object_size + 15) & ~(size_t)15;
+	slab->slots = slots;
+	slab->available = slots;
+	slab->memory = malloc(slab->object_size * slots);
+	slab->used = bitset_calloc(bitset_internal_words(slots) << 6);
+	if (!slab->memory || !slab->used ||
+	    pthread_mutex_init(&slab->lock, NULL)) {
+		free(slab->memory);
+		if (slab->used)
+			bitset_free(slab->used);
+		free(slab);
+		return NULL;
+	}
+
+	if (slots & 0x3f) {
+		size_t last = slots >> 6;
+		bitset_slab_put(slab->used, last, ~(uint64_t)0 << (slots & 0x3f));
+	}
+	return slab;
+}
+
+/* bitset_slab_free(slab)
+ |   frees the allocator together with all objects, allocated or not
+ | slab: pointer to a [struct bitset_slab]
+ */
+void bitset_slab_free(struct bitset_slab *slab)
+{
+	pthread_mutex_destroy(&slab->lock);
+	bitset_free(slab->used);
+	free(slab->memory);
+	free(slab);
+}
+
+/* takes up to num free slots, a word at a time; the lock must be held */
+static
+size_t bitset_slab_take(struct bitset_slab *slab, void **objects, size_t num)
+{
+	size_t words = bitset_internal_words(slab->slots);
+	size_t taken = 0;
+
+	for (size_t w = slab->hint; taken < num && w < words; ++w) {
+		uint64_t word = bitset_slab_get(slab->used, w);
+		uint64_t clear = ~word;
+		if (!clear) {
+			slab->hint = w + 1;
+			continue;
+		}
+		for (; clear && taken < num; clear &= clear - 1) {
+			unsigned int bit = bitset_internal_ctz(clear);
+			word |= (uint64_t)1 << bit;
+			objects[taken++] = slab->memory +
+				((w << 6) + bit) * slab->object_size;
+		}
+		bitset_slab_put(slab->used, w, word);
+		slab->hint = ~word ? w : w + 1;
+	}
+
+	slab->available -= taken;
+	return taken;
+}
+
+/* returns num objects to the free map; the lock must be held */
+static
+void bitset_slab_give(struct bitset_slab *slab, void **objects, size_t num)
+{
+	for (size_t i = 0; i < num; ++i) {
+		size_t slot = ((unsigned char *)objects[i] - slab->memory) /
+		              slab->object_size;
+		size_t w = slot >> 6;
+		uint64_t word = bitset_slab_get(slab->used, w);
+		bitset_slab_put(slab->used, w,
+		                word & ~((uint64_t)1 << (slot & 0x3f)));
+		if (w < slab->hint)
+			slab->hint = w;
+	}
+	slab->available += num;
+}
+
+/* bitset_slab_alloc(slab)
+ |   allocates one object, searching the free map for the first clear
+ |   bit from the cached hint on;
+ |   returns a pointer to the object or NULL if all slots are in use
+ | slab: valid pointer to a [struct bitset_slab]
+ */
+void *bitset_slab_alloc(struct bitset_slab *slab)
+{
+	void *object = NULL;
+	pthread_mutex_lock(&slab->lock);
+	bitset_slab_take(slab, &object, 1);
+	pthread_mutex_unlock(&slab->lock);
+	return object;
+}
+
+/* bitset_slab_release(slab, object)
+ |   returns an object to the allocator
+ | slab:   valid pointer to a [struct bitset_slab]
+ | object: pointer returned by one of the allocation functions
+ */
+void bitset_slab_release(struct bitset_slab *slab, void *object)
+{
+	pthread_mutex_lock(&slab->lock);
+	bitset_slab_give(slab, &object, 1);
+	pthread_mutex_unlock(&slab->lock);
+}
+
+/* bitset_slab_alloc_batch(slab, objects, num)
+ |   allocates up to num objects under a single lock, claiming all
+ |   needed clear bits of a word with one store;
+ |   returns the number of objects allocated
+ | slab:    valid pointer to a [struct bitset_slab]
+ | objects: pointer to memory for num object pointers
+ | num:     number of objects to allocate
+ */
+size_t bitset_slab_alloc_batch(struct bitset_slab *slab, void **objects,
+                               size_t num)
+{
+	pthread_mutex_lock(&slab->lock);
+	size_t taken = bitset_slab_take(slab, objects, num);
+	pthread_mutex_unlock(&slab->lock);
+	return taken;
+}
+
+/* bitset_slab_release_batch(slab, objects, num)
+ |   returns num objects to the allocator under a single lock
+ | slab:    valid pointer to a [struct bitset_slab]
+ | objects: pointers returned by the allocation functions
+ | num:     number of objects
+ */
+void bitset_slab_release_batch(struct bitset_slab *slab, void **objects,
+                               size_t num)
+{
+	pthread_mutex_lock(&slab->lock);
+	bitset_slab_give(slab, objects, num);
+	pthread_mutex_unlock(&slab->lock);
+}
+
+/* bitset_slab_cache_init(cache, slab)
+ |   initializes an empty per-thread cache in front of a shared slab;
+ |   a cache must only be used by one thread at a time
+ | cache: pointer to a [struct bitset_slab_cache]
+ | slab:  valid pointer to a [struct bitset_slab]
+ */
+void bitset_slab_cache_init(struct bitset_slab_cache *cache,
+                            struct bitset_slab *slab)
+{
+	cache->slab = slab;
+	cache->num = 0;
+}
+
+/* bitset_slab_cache_alloc(cache)
+ |   allocates one object from the cache, refilling it with half its
+ |   capacity from the shared slab when it is empty;
+ |   returns a pointer to the object or NULL if all slots are in use
+ | cache: valid pointer to a [struct bitset_slab_cache]
+ */
+void *bitset_slab_cache_alloc(struct bitset_slab_cache *cache)
+{
+	if (!cache->num)
+		cache->num = bitset_slab_alloc_batch(cache->slab, cache->objects,
+		                                     BITSET_SLAB_CACHE / 2);
+	return cache->num ? cache->objects[--cache->num] : NULL;
+}
+
+/* bitset_slab_cache_release(cache, object)
+ |   returns an object to the cache, draining half of the cache to the
+ |   shared slab when it is full
+ | cache:  valid pointer to a [struct bitset_slab_cache]
+ | object: pointer returned by an allocation function of the same slab
+ */
+void bitset_slab_cache_release(struct bitset_slab_cache *cache, void *object)
+{
+	if (cache->num == BITSET_SLAB_CACHE) {
+		cache->num -= BITSET_SLAB_CACHE / 2;
+		bitset_slab_release_batch(cache->slab, cache->objects + cache->num,
+		                          BITSET_SLAB_CACHE / 2);
+	}
+	cache->objects[cache->num++] = object;
+}
+
+/* bitset_slab_cache_flush(cache)
+ |   returns all cached objects to the shared slab
+ | cache: valid pointer to a [struct bitset_slab_cache]
+ */
+void bitset_slab_cache_flush(struct bitset_slab_cache *cache)
+{
+	bitset_slab_release_batch(cache->slab, cache->objects, cache->num);
+	cache->num = 0;
+}
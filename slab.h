@@ -0,0 +1,64 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef BITSET_SLAB_H
+#define BITSET_SLAB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitset.h"
+
+/* number of objects a per-thread cache can hold */
+#define BITSET_SLAB_CACHE 64
+
+/* fixed-size object allocator over one block of memory; bit i of
+ | used is set while slot i is handed out. All words before hint
+ | are known to be full */
+struct bitset_slab {
+	unsigned char *memory;
+	size_t object_size;
+	size_t slots;
+	size_t available;
+	size_t hint;
+	struct bitset *used;
+	pthread_mutex_t lock;
+};
+
+/* per-thread cache in front of a shared slab; refilled and drained
+ | in batches of half its capacity so the lock is taken rarely */
+struct bitset_slab_cache {
+	struct bitset_slab *slab;
+	size_t num;
+	void *objects[BITSET_SLAB_CACHE];
+};
+
+struct bitset_slab *bitset_slab_new(size_t object_size, size_t slots);
+void bitset_slab_free(struct bitset_slab *slab);
+
+void *bitset_slab_alloc(struct bitset_slab *slab);
+void bitset_slab_release(struct bitset_slab *slab, void *object);
+size_t bitset_slab_alloc_batch(struct bitset_slab *slab, void **objects,
+                               size_t num);
+void bitset_slab_release_batch(struct bitset_slab *slab, void **objects,
+                               size_t num);
+
+void bitset_slab_cache_init(struct bitset_slab_cache *cache,
+                            struct bitset_slab *slab);
+void *bitset_slab_cache_alloc(struct bitset_slab_cache *cache);
+void bitset_slab_cache_release(struct bitset_slab_cache *cache, void *object);
+void bitset_slab_cache_flush(struct bitset_slab_cache *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BITSET_SLAB_H */
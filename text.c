@@ -0,0 +1,276 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset.h"
+#include "text.h"
+#include "internal.c"
+
+#define BITSET_TEXT_ONES 0x0101010101010101ULL
+
+/* resizes the set to exactly size bits, also for an empty set */
+static
+int bitset_text_resize(struct bitset *set, size_t size)
+{
+	if (!size) {
+		set->size = 0;
+		return 1;
+	}
+	bitset_resize(set, size);
+	return set->data != NULL;
+}
+
+/* bitset_parse_binary(set, str)
+ |   parses a string of '0' and '1' characters, the first character
+ |   being bit 0; the set is resized to the number of characters.
+ |   Eight characters are packed into a byte with one multiplication;
+ |   returns the number of characters consumed, parsing stops at the
+ |   first other character
+ | set: valid pointer to a [struct bitset]
+ | str: null-terminated string
+ */
+size_t bitset_parse_binary(struct bitset *set, const char *str)
+{
+	size_t len = 0;
+	while (str[len] == '0' || str[len] == '1')
+		++len;
+	if (!bitset_text_resize(set, len))
+		return 0;
+
+	size_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		uint64_t x;
+		memcpy(&x, str + i, 8);
+		x = bitset_internal_le64(x) & BITSET_TEXT_ONES;
+		/* gathers bit 8j into bit (56 + j), no two products collide */
+		set->data[i >> 3] = (x * 0x0102040810204080ULL) >> 56;
+	}
+	if (i < len) {
+		unsigned char byte = 0;
+		for (size_t j = 0; i + j < len; ++j)
+			byte |= (str[i + j] & 1) << j;
+		set->data[i >> 3] = byte;
+	}
+	bitset_recount(set);
+	return len;
+}
+
+/* bitset_format_binary(set, str)
+ |   writes the bits as '0' and '1' characters followed by a null
+ |   terminator, bit 0 first; every byte is spread into eight
+ |   characters with one multiplication;
+ |   returns the number of characters written - that is the size
+ | set: valid pointer to a [struct bitset]
+ | str: pointer to memory for (size + 1) characters
+ */
+size_t bitset_format_binary(struct bitset *set, char *str)
+{
+	size_t size = set->size;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t x = set->data[i >> 3] * BITSET_TEXT_ONES;
+		x &= 0x8040201008040201ULL;
+		x = ((x + 0x7f7f7f7f7f7f7f7fULL) >> 7) & BITSET_TEXT_ONES;
+		x = bitset_internal_le64(x + 0x3030303030303030ULL);
+		memcpy(str + i, &x, 8);
+	}
+	for (; i < size; ++i)
+		str[i] = '0' + (set->data[i >> 3] >> (i & 0x7) & 1);
+	str[size] = '\0';
+	return size;
+}
+
+static
+int bitset_text_hex_value(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/* bitset_parse_hex(set, str)
+ |   parses a string of hexadecimal digits as one number, the most
+ |   significant digit first, so that the last digit holds bits 0 to 3;
+ |   the set is resized to four bits per digit;
+ |   returns the number of characters consumed, parsing stops at the
+ |   first character that is not a hexadecimal digit
+ | set: valid pointer to a [struct bitset]
+ | str: null-terminated string
+ */
+size_t bitset_parse_hex(struct bitset *set, const char *str)
+{
+	size_t len = 0;
+	while (bitset_text_hex_value(str[len]) >= 0)
+		++len;
+	if (!bitset_text_resize(set, len * 4))
+		return 0;
+
+	/* two digits per byte, starting from the end of the string */
+	const char *end = str + len;
+	for (size_t b = 0; b < (len + 1) / 2; ++b) {
+		unsigned char byte = bitset_text_hex_value(*--end);
+		if (end > str)
+			byte |= bitset_text_hex_value(*--end) << 4;
+		set->data[b] = byte;
+	}
+	bitset_recount(set);
+	return len;
+}
+
+/* bitset_format_hex(set, str)
+ |   writes the bits as one hexadecimal number, the most significant
+ |   digit first, followed by a null terminator; the last digit holds
+ |   bits 0 to 3;
+ |   returns the number of digits written - that is (size + 3) / 4
+ | set: valid pointer to a [struct bitset]
+ | str: pointer to memory for ((size + 3) / 4 + 1) characters
+ */
+size_t bitset_format_hex(struct bitset *set, char *str)
+{
+	static const char digits[] = "0123456789abcdef";
+	size_t len = (set->size + 3) / 4;
+	char *out = str + len;
+	*out = '\0';
+
+	for (size_t b = 0; out > str; ++b) {
+		unsigned char byte = set->data[b];
+		if (b == (len - 1) / 2 && (set->size & 0x7))
+			byte &= ~(~0U << (set->size & 0x7));
+		*--out = digits[byte & 0xf];
+		if (out > str)
+			*--out = digits[byte >> 4];
+	}
+	return len;
+}
+
+/* parses a decimal number; returns the number of digits */
+static
+size_t bitset_text_number(const char *str, size_t *value)
+{
+	size_t len = 0;
+	*value = 0;
+	for (; str[len] >= '0' && str[len] <= '9'; ++len) {
+		size_t digit = str[len] - '0';
+		if (*value > (SIZE_MAX - digit) / 10)
+			return 0;
+		*value = *value * 10 + digit;
+	}
+	return len;
+}
+
+/* bitset_parse_ranges(set, str)
+ |   parses a comma-separated list of bit indices and inclusive ranges
+ |   like "0-3,7,12-40"; the set is cleared first and every listed bit
+ |   is set, ranges with bitset_rset;
+ |   returns the number of characters consumed, parsing stops at the
+ |   first malformed entry or index beyond the size of the set
+ | set: valid pointer to a [struct bitset]
+ | str: null-terminated string
+ */
+size_t bitset_parse_ranges(struct bitset *set, const char *str)
+{
+	size_t pos = 0;
+	if (set->size)
+		bitset_clear(set);
+
+	for (;;) {
+		size_t begin, end, n;
+		if (!(n = bitset_text_number(str + pos, &begin)))
+			return pos;
+		end = begin;
+		if (str[pos + n] == '-') {
+			size_t m = bitset_text_number(str + pos + n + 1, &end);
+			if (!m)
+				return pos;
+			n += m + 1;
+		}
+		if (end < begin || end >= set->size)
+			return pos;
+
+		bitset_rset(set, begin, end + 1);
+		pos += n;
+		if (str[pos] != ',')
+			return pos;
+		++pos;
+	}
+}
+
+/* appends a decimal number, counting characters that do not fit */
+static
+size_t bitset_text_put(char *str, size_t len, size_t at, size_t value)
+{
+	char digits[24];
+	size_t n = 0;
+	do
+		digits[n++] = '0' + value % 10;
+	while (value /= 10);
+	while (n--) {
+		if (at + 1 < len)
+			str[at] = digits[n];
+		++at;
+	}
+	return at;
+}
+
+/* bitset_format_ranges(set, str, len)
+ |   writes the set bits as a comma-separated list of indices and
+ |   inclusive ranges like "0-3,7,12-40", found by skipping whole
+ |   words while searching for the start and end of every run; at most
+ |   (len - 1) characters and a null terminator are written;
+ |   returns the length of the complete list, which exceeds (len - 1)
+ |   if str was too small
+ | set: valid pointer to a [struct bitset]
+ | str: pointer to memory for len characters, may be NULL if len is 0
+ | len: size of the memory pointed to by str
+ */
+size_t bitset_format_ranges(struct bitset *set, char *str, size_t len)
+{
+	size_t words = bitset_internal_words(set->size);
+	size_t at = 0, w = 0;
+	uint64_t word = bitset_word(set, 0);
+
+	for (;;) {
+		while (!word && ++w < words)
+			word = bitset_word(set, w);
+		if (!word)
+			break;
+		size_t begin = (w << 6) + bitset_internal_ctz(word);
+		uint64_t rest = ~word & (~(uint64_t)0 << (begin & 0x3f));
+		while (!rest && ++w < words)
+			rest = ~bitset_word(set, w);
+		size_t end = rest ? (w << 6) + bitset_internal_ctz(rest) : set->size;
+
+		if (at) {
+			if (at + 1 < len)
+				str[at] = ',';
+			++at;
+		}
+		at = bitset_text_put(str, len, at, begin);
+		if (end - begin > 1) {
+			if (at + 1 < len)
+				str[at] = '-';
+			++at;
+			at = bitset_text_put(str, len, at, end - 1);
+		}
+
+		if (end >= set->size)
+			break;
+		w = end >> 6;
+		word = bitset_word(set, w) & (~(uint64_t)0 << (end & 0x3f));
+	}
+
+	if (len)
+		str[at < len ? at : len - 1] = '\0';
+	return at;
+}
@@ -0,0 +1,30 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef BITSET_TEXT_H
+#define BITSET_TEXT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitset.h"
+
+size_t bitset_parse_binary(struct bitset *set, const char *str);
+size_t bitset_format_binary(struct bitset *set, char *str);
+size_t bitset_parse_hex(struct bitset *set, const char *str);
+size_t bitset_format_hex(struct bitset *set, char *str);
+size_t bitset_parse_ranges(struct bitset *set, const char *str);
+size_t bitset_format_ranges(struct bitset *set, char *str, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BITSET_TEXT_H */
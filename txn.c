@@ -0,0 +1,323 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset.h"
+#include "txn.h"
+#include "internal.c"
+
+#define BITSET_TXN_WORDS (BITSET_TXN_BLOCK / 64)
+
+/* words are accessed atomically in the little-endian layout of the set */
+static inline
+uint64_t bitset_txn_load(struct bitset_shared *shared, size_t w)
+{
+	uint64_t *words = (uint64_t *)shared->set->data;
+	return bitset_internal_le64(__atomic_load_n(words + w, __ATOMIC_RELAXED));
+}
+
+static inline
+void bitset_txn_store(struct bitset_shared *shared, size_t w, uint64_t word)
+{
+	uint64_t *words = (uint64_t *)shared->set->data;
+	__atomic_store_n(words + w, bitset_internal_le64(word), __ATOMIC_RELAXED);
+}
+
+/* bitset_shared_new(size)
+ |   creates a cleared bitset for concurrent transactions;
+ |   returns a pointer to the allocated struct
+ | size: number of bits
+ */
+struct bitset_shared *bitset_shared_new(size_t size)
+{
+	struct bitset_shared *shared = calloc(1, sizeof(struct bitset_shared));
+	if (!shared)
+		return NULL;
+	shared->blocks = size / BITSET_TXN_BLOCK + 1;
+	shared->set = bitset_calloc(shared->blocks * BITSET_TXN_BLOCK);
+	shared->seqs = calloc(shared->blocks, sizeof(uint32_t));
+	if (!shared->set || !shared->seqs) {
+		if (shared->set)
+			bitset_free(shared->set);
+		free(shared->seqs);
+		free(shared);
+		return NULL;
+	}
+	shared->set->size = size;
+	return shared;
+}
+
+/* bitset_shared_free(shared)
+ |   frees memory associated with the given shared bitset
+ | shared: pointer to a [struct bitset_shared]
+ */
+void bitset_shared_free(struct bitset_shared *shared)
+{
+	bitset_free(shared->set);
+	free(shared->seqs);
+	free(shared);
+}
+
+/* bitset_shared_read(shared, index, seq, size)
+ |   copies the bits index to (index + size - 1) into seq as one
+ |   consistent snapshot: every committed transaction is seen either
+ |   completely or not at all. The sequence counters of the blocks are
+ |   read before and after the copy, and it is repeated until no
+ |   transaction has written to them in between;
+ |   returns the number of bits read - that is the size argument
+ | shared: valid pointer to a [struct bitset_shared]
+ | index:  the offset at which the reading should start
+ | seq:    pointer to memory for (size + 7) / 8 bytes
+ | size:   the amount of bits to copy
+ */
+size_t bitset_shared_read(struct bitset_shared *shared, size_t index,
+                          unsigned char *seq, size_t size)
+{
+	if (!size)
+		return 0;
+	size_t first = index / BITSET_TXN_BLOCK;
+	size_t last = (index + size - 1) / BITSET_TXN_BLOCK;
+	size_t w0 = index >> 6;
+	unsigned int shift = index & 0x3f;
+	size_t bytes = bitset_internal_bytes(size);
+
+	for (;;) {
+		uint32_t before = 0;
+		int busy = 0;
+		for (size_t b = first; b <= last; ++b) {
+			uint32_t s = __atomic_load_n(shared->seqs + b, __ATOMIC_ACQUIRE);
+			busy |= s & 1;
+			before += s;
+		}
+		if (busy)
+			continue;
+
+		for (size_t i = 0; i < bytes; i += 8) {
+			size_t w = w0 + (i >> 3);
+			uint64_t word = bitset_txn_load(shared, w) >> shift;
+			if (shift && w + 1 < shared->blocks * BITSET_TXN_WORDS)
+				word |= bitset_txn_load(shared, w + 1) << (64 - shift);
+			bitset_internal_store(seq + i, word, bytes - i < 8 ? bytes - i : 8);
+		}
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		uint32_t after = 0;
+		for (size_t b = first; b <= last; ++b)
+			after += __atomic_load_n(shared->seqs + b, __ATOMIC_RELAXED);
+		/* a commit adds 2 to a counter; a lock that is given up drops
+		 | it back to the even value it had, and only before anything
+		 | was written. No counter ends up below its value in before,
+		 | so equal sums mean no block was committed in between */
+		if (after == before)
+			break;
+	}
+
+	if (size & 0x7)
+		seq[bytes - 1] &= ~(~0U << (size & 0x7));
+	return size;
+}
+
+/* bitset_shared_get(shared, index)
+ |   gets the state of a bit as committed by the last transaction that
+ |   wrote it
+ | shared: valid pointer to a [struct bitset_shared]
+ | index:  the offset of the bit
+ */
+unsigned int bitset_shared_get(struct bitset_shared *shared, size_t index)
+{
+	unsigned char bit;
+	bitset_shared_read(shared, index, &bit, 1);
+	return bit;
+}
+
+/* bitset_txn_init(txn, shared)
+ |   starts an empty transaction on a shared bitset
+ | txn:    pointer to a [struct bitset_txn]
+ | shared: valid pointer to a [struct bitset_shared]
+ */
+void bitset_txn_init(struct bitset_txn *txn, struct bitset_shared *shared)
+{
+	memset(txn, 0, sizeof(struct bitset_txn));
+	txn->shared = shared;
+}
+
+/* bitset_txn_release(txn)
+ |   frees the memory of the recorded operations
+ | txn: valid pointer to a [struct bitset_txn]
+ */
+void bitset_txn_release(struct bitset_txn *txn)
+{
+	free(txn->ops);
+	free(txn->blocks);
+	bitset_txn_init(txn, txn->shared);
+}
+
+/* bitset_txn_record(txn, begin, end, kind)
+ |   records an operation on the bits begin to (end - 1); nothing is
+ |   written before bitset_txn_commit. The commit checks every
+ |   expectation against the state before the transaction, then writes
+ |   the changes in the order they were recorded, so an expectation
+ |   never sees a change of its own transaction;
+ |   returns 1 on success, 0 if memory could not be allocated
+ | txn:   valid pointer to a [struct bitset_txn]
+ | begin: index of the first bit (inclusive)
+ | end:   index of the ending bit (exclusive)
+ | kind:  BITSET_TXN_SET, BITSET_TXN_CLEAR, BITSET_TXN_EXPECT_SET or
+ |        BITSET_TXN_EXPECT_CLEAR
+ */
+int bitset_txn_record(struct bitset_txn *txn, size_t begin, size_t end,
+                      unsigned int kind)
+{
+	if (begin >= end)
+		return 1;
+	if (txn->num == txn->capacity) {
+		size_t capacity = txn->capacity ? txn->capacity * 2 : 8;
+		struct bitset_txn_op *ops = realloc(txn->ops,
+		                            capacity * sizeof(struct bitset_txn_op));
+		if (!ops)
+			return 0;
+		txn->ops = ops;
+		txn->capacity = capacity;
+	}
+	struct bitset_txn_op op = { begin, end, kind };
+	txn->ops[txn->num++] = op;
+	return 1;
+}
+
+static
+int bitset_txn_compare(const void *a, const void *b)
+{
+	size_t x = *(const size_t *)a, y = *(const size_t *)b;
+	return (x > y) - (x < y);
+}
+
+/* sorted list of the distinct blocks touched by the operations */
+static
+int bitset_txn_collect(struct bitset_txn *txn)
+{
+	size_t num = 0;
+	for (size_t i = 0; i < txn->num; ++i)
+		num += (txn->ops[i].end - 1) / BITSET_TXN_BLOCK -
+		       txn->ops[i].begin / BITSET_TXN_BLOCK + 1;
+	size_t *blocks = realloc(txn->blocks, num * sizeof(size_t));
+	if (!blocks)
+		return 0;
+	txn->blocks = blocks;
+
+	num = 0;
+	for (size_t i = 0; i < txn->num; ++i)
+		for (size_t b = txn->ops[i].begin / BITSET_TXN_BLOCK;
+		     b <= (txn->ops[i].end - 1) / BITSET_TXN_BLOCK; ++b)
+			blocks[num++] = b;
+	qsort(blocks, num, sizeof(size_t), bitset_txn_compare);
+
+	size_t unique = 0;
+	for (size_t i = 0; i < num; ++i)
+		if (!unique || blocks[unique - 1] != blocks[i])
+			blocks[unique++] = blocks[i];
+	txn->num_blocks = unique;
+	return 1;
+}
+
+/* releases the first num locked blocks; counters advance past the odd
+ | value if the blocks were written, and return to it otherwise */
+static
+void bitset_txn_unlock(struct bitset_txn *txn, size_t num, int written)
+{
+	uint32_t *seqs = txn->shared->seqs;
+	for (size_t i = 0; i < num; ++i) {
+		uint32_t *seq = seqs + txn->blocks[i];
+		uint32_t s = __atomic_load_n(seq, __ATOMIC_RELAXED);
+		__atomic_store_n(seq, written ? s + 1 : s - 1, __ATOMIC_RELEASE);
+	}
+}
+
+/* checks or applies one operation word by word, with all of its blocks
+ | locked */
+static
+int bitset_txn_apply(struct bitset_shared *shared, struct bitset_txn_op *op)
+{
+	size_t first = op->begin >> 6;
+	size_t last = (op->end - 1) >> 6;
+	for (size_t w = first; w <= last; ++w) {
+		uint64_t mask = ~(uint64_t)0;
+		if (w == first)
+			mask &= ~(uint64_t)0 << (op->begin & 0x3f);
+		if (w == last)
+			mask &= ~(uint64_t)0 >> (63 - ((op->end - 1) & 0x3f));
+
+		uint64_t word = bitset_txn_load(shared, w);
+		switch (op->kind) {
+		case BITSET_TXN_CLEAR:
+			bitset_txn_store(shared, w, word & ~mask);
+			break;
+		case BITSET_TXN_SET:
+			bitset_txn_store(shared, w, word | mask);
+			break;
+		case BITSET_TXN_EXPECT_CLEAR:
+			if (word & mask)
+				return 0;
+			break;
+		default:
+			if ((word & mask) != mask)
+				return 0;
+			break;
+		}
+	}
+	return 1;
+}
+
+/* bitset_txn_commit(txn)
+ |   applies all recorded operations at once: the blocks they touch are
+ |   locked in ascending order by making their sequence counters odd,
+ |   which fails right away if another transaction holds one of them.
+ |   Expectations are checked before anything is written, and readers
+ |   retry while any of the blocks is locked. Writers of other blocks
+ |   proceed in parallel. On success the recorded operations are
+ |   removed, on failure they are kept for a retry;
+ |   returns 1 if the transaction was committed, 0 on a conflict with
+ |   another transaction, a failed expectation or if memory could not
+ |   be allocated (nothing is written)
+ | txn: valid pointer to a [struct bitset_txn]
+ */
+int bitset_txn_commit(struct bitset_txn *txn)
+{
+	struct bitset_shared *shared = txn->shared;
+	if (!txn->num)
+		return 1;
+	if (!bitset_txn_collect(txn))
+		return 0;
+
+	for (size_t i = 0; i < txn->num_blocks; ++i) {
+		uint32_t *seq = shared->seqs + txn->blocks[i];
+		uint32_t s = __atomic_load_n(seq, __ATOMIC_RELAXED);
+		if ((s & 1) || !__atomic_compare_exchange_n(seq, &s, s + 1, 0,
+		               __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			bitset_txn_unlock(txn, i, 0);
+			return 0;
+		}
+	}
+	/* the odd counters become visible before any word changes */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	for (size_t i = 0; i < txn->num; ++i)
+		if (txn->ops[i].kind >= BITSET_TXN_EXPECT_CLEAR &&
+		    !bitset_txn_apply(shared, txn->ops + i)) {
+			bitset_txn_unlock(txn, txn->num_blocks, 0);
+			return 0;
+		}
+	for (size_t i = 0; i < txn->num; ++i)
+		if (txn->ops[i].kind < BITSET_TXN_EXPECT_CLEAR)
+			bitset_txn_apply(shared, txn->ops + i);
+
+	bitset_txn_unlock(txn, txn->num_blocks, 1);
+	txn->num = 0;
+	return 1;
+}
@@ -0,0 +1,117 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef BITSET_TXN_H
+#define BITSET_TXN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitset.h"
+
+/* bits guarded by one sequence counter */
+#define BITSET_TXN_BLOCK 512
+
+/* kinds of recorded operations */
+#define BITSET_TXN_CLEAR        0
+#define BITSET_TXN_SET          1
+#define BITSET_TXN_EXPECT_CLEAR 2
+#define BITSET_TXN_EXPECT_SET   3
+
+/* bitset shared between threads that is changed by transactions only;
+ | every block of bits has a sequence counter that is odd while a
+ | transaction writes to the block (uses the GCC/Clang __atomic
+ | builtins) */
+struct bitset_shared {
+	struct bitset *set;
+	size_t blocks;
+	uint32_t *seqs;
+};
+
+struct bitset_txn_op {
+	size_t begin;
+	size_t end;
+	unsigned int kind;
+};
+
+/* operations recorded for one atomic commit, and the blocks they touch */
+struct bitset_txn {
+	struct bitset_shared *shared;
+	struct bitset_txn_op *ops;
+	size_t num;
+	size_t capacity;
+	size_t *blocks;
+	size_t num_blocks;
+};
+
+struct bitset_shared *bitset_shared_new(size_t size);
+void bitset_shared_free(struct bitset_shared *shared);
+unsigned int bitset_shared_get(struct bitset_shared *shared, size_t index);
+size_t bitset_shared_read(struct bitset_shared *shared, size_t index,
+                          unsigned char *seq, size_t size);
+
+void bitset_txn_init(struct bitset_txn *txn, struct bitset_shared *shared);
+void bitset_txn_release(struct bitset_txn *txn);
+int bitset_txn_record(struct bitset_txn *txn, size_t begin, size_t end,
+                      unsigned int kind);
+int bitset_txn_commit(struct bitset_txn *txn);
+
+/* bitset_txn_set(txn, index, state)
+ |   records setting a bit to the specified state;
+ |   returns 1 on success, 0 if memory could not be allocated
+ | txn:   valid pointer to a [struct bitset_txn]
+ | index: the offset of the bit
+ | state: a boolean value expressing the bit's new state
+ */
+static inline
+int bitset_txn_set(struct bitset_txn *txn, size_t index, unsigned int state)
+{
+	return bitset_txn_record(txn, index, index + 1,
+	                         state ? BITSET_TXN_SET : BITSET_TXN_CLEAR);
+}
+
+/* bitset_txn_expect(txn, index, state)
+ |   records the condition that a bit has the specified state when the
+ |   transaction commits, otherwise the commit fails
+ | txn:   valid pointer to a [struct bitset_txn]
+ | index: the offset of the bit
+ | state: a boolean value expressing the expected state
+ */
+static inline
+int bitset_txn_expect(struct bitset_txn *txn, size_t index, unsigned int state)
+{
+	return bitset_txn_record(txn, index, index + 1,
+	                         state ? BITSET_TXN_EXPECT_SET
+	                               : BITSET_TXN_EXPECT_CLEAR);
+}
+
+/* bitset_txn_rset(txn, begin, end)
+ |   records setting the bits begin to (end - 1)
+ */
+static inline
+int bitset_txn_rset(struct bitset_txn *txn, size_t begin, size_t end)
+{
+	return bitset_txn_record(txn, begin, end, BITSET_TXN_SET);
+}
+
+/* bitset_txn_rclear(txn, begin, end)
+ |   records clearing the bits begin to (end - 1)
+ */
+static inline
+int bitset_txn_rclear(struct bitset_txn *txn, size_t begin, size_t end)
+{
+	return bitset_txn_record(txn, begin, end, BITSET_TXN_CLEAR);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BITSET_TXN_H */
@@ -0,0 +1,193 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset.h"
+#include "veb.h"
+#include "internal.c"
+
+/* levels are allocated in whole words, so words can be accessed
+ | directly without masking */
+static inline
+uint64_t bitset_veb_get(struct bitset *level, size_t w)
+{
+	return bitset_internal_load(level->data + (w << 3), 8);
+}
+
+static inline
+void bitset_veb_put(struct bitset *level, size_t w, uint64_t word)
+{
+	bitset_internal_store(level->data + (w << 3), word, 8);
+}
+
+/* bitset_veb_new(universe)
+ |   creates a new, empty set for the integers 0 to (universe - 1)
+ |   with one summary level per factor of 64;
+ |   returns a pointer to the allocated struct
+ | universe: number of representable integers, at least 1
+ */
+struct bitset_veb *bitset_veb_new(size_t universe)
+{
+	if (!universe)
+		return NULL;
+	struct bitset_veb *veb = calloc(1, sizeof(struct bitset_veb));
+	if (!veb)
+		return NULL;
+	veb->universe = universe;
+
+	size_t bits = universe;
+	do {
+		struct bitset *level = bitset_calloc(bitset_internal_words(bits) << 6);
+		if (!level) {
+			bitset_veb_free(veb);
+			return NULL;
+		}
+		veb->levels[veb->height++] = level;
+		bits = bitset_internal_words(bits);
+	} while (bits > 1);
+
+	return veb;
+}
+
+/* bitset_veb_free(veb)
+ |   frees memory associated with the given set
+ | veb: pointer to a [struct bitset_veb]
+ */
+void bitset_veb_free(struct bitset_veb *veb)
+{
+	for (unsigned int l = 0; l < veb->height; ++l)
+		bitset_free(veb->levels[l]);
+	free(veb);
+}
+
+/* bitset_veb_insert(veb, x)
+ |   adds an integer to the set, marking the summaries above it only
+ |   as far as they were empty;
+ |   returns 1 if x was added, 0 if it was already present
+ | veb: valid pointer to a [struct bitset_veb]
+ | x:   integer smaller than the universe
+ */
+int bitset_veb_insert(struct bitset_veb *veb, size_t x)
+{
+	if (bitset_veb_contains(veb, x))
+		return 0;
+
+	++veb->count;
+	for (unsigned int l = 0; l < veb->height; ++l, x >>= 6) {
+		struct bitset *level = veb->levels[l];
+		uint64_t word = bitset_veb_get(level, x >> 6);
+		bitset_veb_put(level, x >> 6, word | (uint64_t)1 << (x & 0x3f));
+		if (word)
+			break;
+	}
+	return 1;
+}
+
+/* bitset_veb_erase(veb, x)
+ |   removes an integer from the set, clearing the summaries above it
+ |   as far as they became empty;
+ |   returns 1 if x was removed, 0 if it was not present
+ | veb: valid pointer to a [struct bitset_veb]
+ | x:   integer smaller than the universe
+ */
+int bitset_veb_erase(struct bitset_veb *veb, size_t x)
+{
+	if (!bitset_veb_contains(veb, x))
+		return 0;
+
+	--veb->count;
+	for (unsigned int l = 0; l < veb->height; ++l, x >>= 6) {
+		struct bitset *level = veb->levels[l];
+		uint64_t word = bitset_veb_get(level, x >> 6);
+		word &= ~((uint64_t)1 << (x & 0x3f));
+		bitset_veb_put(level, x >> 6, word);
+		if (word)
+			break;
+	}
+	return 1;
+}
+
+/* bitset_veb_contains(veb, x)
+ |   returns whether the integer is in the set
+ | veb: valid pointer to a [struct bitset_veb]
+ | x:   integer smaller than the universe
+ */
+unsigned int bitset_veb_contains(struct bitset_veb *veb, size_t x)
+{
+	return bitset_veb_get(veb->levels[0], x >> 6) >> (x & 0x3f) & 1;
+}
+
+/* bitset_veb_successor(veb, x)
+ |   returns the smallest element greater than or equal to x, or
+ |   SIZE_MAX if there is none; climbs the summaries until a word with
+ |   a candidate is found and descends again with tzcnt
+ | veb: valid pointer to a [struct bitset_veb]
+ | x:   integer to start from
+ */
+size_t bitset_veb_successor(struct bitset_veb *veb, size_t x)
+{
+	if (x >= veb->universe)
+		return SIZE_MAX;
+
+	unsigned int l = 0;
+	uint64_t word;
+	for (;;) {
+		size_t w = x >> 6;
+		word = bitset_veb_get(veb->levels[l], w) & (~(uint64_t)0 << (x & 0x3f));
+		if (word) {
+			x = (w << 6) + bitset_internal_ctz(word);
+			break;
+		}
+		if (++l == veb->height)
+			return SIZE_MAX;
+		x = w + 1;
+		if (x >= veb->levels[l]->size)
+			return SIZE_MAX;
+	}
+
+	while (l--) {
+		word = bitset_veb_get(veb->levels[l], x);
+		x = (x << 6) + bitset_internal_ctz(word);
+	}
+	return x;
+}
+
+/* bitset_veb_predecessor(veb, x)
+ |   returns the largest element less than or equal to x, or SIZE_MAX
+ |   if there is none; climbs the summaries until a word with a
+ |   candidate is found and descends again with lzcnt
+ | veb: valid pointer to a [struct bitset_veb]
+ | x:   integer to start from
+ */
+size_t bitset_veb_predecessor(struct bitset_veb *veb, size_t x)
+{
+	if (x >= veb->universe)
+		x = veb->universe - 1;
+
+	unsigned int l = 0;
+	uint64_t word;
+	for (;;) {
+		size_t w = x >> 6;
+		word = bitset_veb_get(veb->levels[l], w) & (~(uint64_t)0 >> (63 - (x & 0x3f)));
+		if (word) {
+			x = (w << 6) + 63 - bitset_internal_clz(word);
+			break;
+		}
+		if (++l == veb->height || !w)
+			return SIZE_MAX;
+		x = w - 1;
+	}
+
+	while (l--) {
+		word = bitset_veb_get(veb->levels[l], x);
+		x = (x << 6) + 63 - bitset_internal_clz(word);
+	}
+	return x;
+}
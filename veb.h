@@ -0,0 +1,65 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef BITSET_VEB_H
+#define BITSET_VEB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitset.h"
+
+/* maximum number of summary levels, enough for a 64-bit universe */
+#define BITSET_VEB_LEVELS 11
+
+/* ordered set of integers below a fixed universe; level 0 holds the
+ | elements, bit i of level l + 1 is set iff word i of level l is not
+ | zero, and the top level is a single word */
+struct bitset_veb {
+	size_t universe;
+	size_t count;
+	unsigned int height;
+	struct bitset *levels[BITSET_VEB_LEVELS];
+};
+
+struct bitset_veb *bitset_veb_new(size_t universe);
+void bitset_veb_free(struct bitset_veb *veb);
+
+int bitset_veb_insert(struct bitset_veb *veb, size_t x);
+int bitset_veb_erase(struct bitset_veb *veb, size_t x);
+unsigned int bitset_veb_contains(struct bitset_veb *veb, size_t x);
+size_t bitset_veb_successor(struct bitset_veb *veb, size_t x);
+size_t bitset_veb_predecessor(struct bitset_veb *veb, size_t x);
+
+/* bitset_veb_min(veb)
+ |   returns the smallest element, or SIZE_MAX if the set is empty
+ | veb: valid pointer to a [struct bitset_veb]
+ */
+static inline
+size_t bitset_veb_min(struct bitset_veb *veb)
+{
+	return bitset_veb_successor(veb, 0);
+}
+
+/* bitset_veb_max(veb)
+ |   returns the largest element, or SIZE_MAX if the set is empty
+ | veb: valid pointer to a [struct bitset_veb]
+ */
+static inline
+size_t bitset_veb_max(struct bitset_veb *veb)
+{
+	return bitset_veb_predecessor(veb, veb->universe - 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BITSET_VEB_H */
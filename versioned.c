@@ -0,0 +1,381 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset.h"
+#include "versioned.h"
+#include "internal.c"
+
+#define BITSET_VERSIONED_SHIFT  6 /* log2 of BITSET_VERSIONED_FANOUT */
+#define BITSET_VERSIONED_LEVELS 11 /* enough nodes for a 64-bit size */
+
+/* nodes and blocks both start with their reference count */
+#define bitset_versioned_refs(ptr) (*(size_t *)(ptr))
+
+#define bitset_versioned_bytes(level, height) \
+	((level) < (height) ? sizeof(struct bitset_versioned_node) \
+	                    : sizeof(struct bitset_versioned_block))
+
+/* the child of a node on the path to a block */
+static inline
+void **bitset_versioned_slot(void *ptr, size_t block, unsigned int level,
+                             unsigned int height)
+{
+	struct bitset_versioned_node *node = ptr;
+	unsigned int shift = (height - 1 - level) * BITSET_VERSIONED_SHIFT;
+	return &node->child[(block >> shift) & (BITSET_VERSIONED_FANOUT - 1)];
+}
+
+/* drops one reference to a subtree, freeing what is no longer used */
+static
+void bitset_versioned_release(void *ptr, unsigned int level,
+                              unsigned int height)
+{
+	if (!ptr || --bitset_versioned_refs(ptr))
+		return;
+	if (level < height) {
+		struct bitset_versioned_node *node = ptr;
+		for (size_t i = 0; i < BITSET_VERSIONED_FANOUT; ++i)
+			bitset_versioned_release(node->child[i], level + 1, height);
+	}
+	free(ptr);
+}
+
+static
+void bitset_versioned_drop(struct bitset_versioned *vs,
+                           struct bitset_version *version)
+{
+	bitset_versioned_release(version->root, 0, vs->height);
+	free(version);
+}
+
+/* frees the old versions that are no longer pinned; the writer lock
+ | must be held */
+static
+size_t bitset_versioned_collect(struct bitset_versioned *vs)
+{
+	struct bitset_version *unused = NULL;
+	pthread_mutex_lock(&vs->lock);
+	struct bitset_version **link = &vs->older;
+	while (*link) {
+		struct bitset_version *version = *link;
+		if (version->pins) {
+			link = &version->older;
+			continue;
+		}
+		*link = version->older;
+		version->older = unused;
+		unused = version;
+	}
+	pthread_mutex_unlock(&vs->lock);
+
+	size_t num = 0;
+	for (; unused; ++num) {
+		struct bitset_version *next = unused->older;
+		bitset_versioned_drop(vs, unused);
+		unused = next;
+	}
+	return num;
+}
+
+/* bitset_versioned_new(size)
+ |   creates a versioned bitset whose first version has all bits
+ |   cleared; blocks are only allocated once a bit in them is set;
+ |   returns a pointer to the allocated struct
+ | size: number of bits
+ */
+struct bitset_versioned *bitset_versioned_new(size_t size)
+{
+	struct bitset_versioned *vs = calloc(1, sizeof(struct bitset_versioned));
+	if (!vs)
+		return NULL;
+	vs->size = size;
+	vs->height = 1;
+	size_t blocks = size / BITSET_VERSIONED_BLOCK + 1;
+	for (size_t cap = BITSET_VERSIONED_FANOUT; cap < blocks;
+	     cap <<= BITSET_VERSIONED_SHIFT)
+		++vs->height;
+
+	vs->current = calloc(1, sizeof(struct bitset_version));
+	if (!vs->current) {
+		free(vs);
+		return NULL;
+	}
+	vs->current->pins = 1;
+	if (pthread_mutex_init(&vs->lock, NULL)) {
+		free(vs->current);
+		free(vs);
+		return NULL;
+	}
+	if (pthread_mutex_init(&vs->writer, NULL)) {
+		pthread_mutex_destroy(&vs->lock);
+		free(vs->current);
+		free(vs);
+		return NULL;
+	}
+	return vs;
+}
+
+/* bitset_versioned_free(vs)
+ |   frees all versions, pinned or not; no reader or writer may be active
+ | vs: pointer to a [struct bitset_versioned]
+ */
+void bitset_versioned_free(struct bitset_versioned *vs)
+{
+	while (vs->older) {
+		struct bitset_version *next = vs->older->older;
+		bitset_versioned_drop(vs, vs->older);
+		vs->older = next;
+	}
+	bitset_versioned_drop(vs, vs->current);
+	pthread_mutex_destroy(&vs->writer);
+	pthread_mutex_destroy(&vs->lock);
+	free(vs);
+}
+
+/* bitset_versioned_pin(vs)
+ |   pins the current version for reading; it stays unchanged and
+ |   allocated until it is unpinned, whatever writers commit meanwhile;
+ |   returns the pinned version
+ | vs: valid pointer to a [struct bitset_versioned]
+ */
+struct bitset_version *bitset_versioned_pin(struct bitset_versioned *vs)
+{
+	pthread_mutex_lock(&vs->lock);
+	struct bitset_version *version = vs->current;
+	++version->pins;
+	pthread_mutex_unlock(&vs->lock);
+	return version;
+}
+
+/* bitset_versioned_unpin(vs, version)
+ |   releases a pinned version; an old version is reclaimed right away
+ |   unless a writer is active, then when it commits or aborts
+ | vs:      valid pointer to a [struct bitset_versioned]
+ | version: version returned by bitset_versioned_pin
+ */
+void bitset_versioned_unpin(struct bitset_versioned *vs,
+                            struct bitset_version *version)
+{
+	pthread_mutex_lock(&vs->lock);
+	int unused = !--version->pins;
+	pthread_mutex_unlock(&vs->lock);
+
+	if (unused && !pthread_mutex_trylock(&vs->writer)) {
+		bitset_versioned_collect(vs);
+		pthread_mutex_unlock(&vs->writer);
+	}
+}
+
+/* bitset_versioned_reclaim(vs)
+ |   frees all old versions that are not pinned, waiting for an active
+ |   writer to finish;
+ |   returns the number of versions freed
+ | vs: valid pointer to a [struct bitset_versioned]
+ */
+size_t bitset_versioned_reclaim(struct bitset_versioned *vs)
+{
+	pthread_mutex_lock(&vs->writer);
+	size_t num = bitset_versioned_collect(vs);
+	pthread_mutex_unlock(&vs->writer);
+	return num;
+}
+
+/* bitset_versioned_begin(vs)
+ |   starts a new version as a draft that shares all blocks with the
+ |   current one; waits for other writers, which are excluded until
+ |   the draft is committed or aborted;
+ |   returns the draft, or NULL if memory could not be allocated
+ | vs: valid pointer to a [struct bitset_versioned]
+ */
+struct bitset_version *bitset_versioned_begin(struct bitset_versioned *vs)
+{
+	struct bitset_version *draft = malloc(sizeof(struct bitset_version));
+	if (!draft)
+		return NULL;
+	pthread_mutex_lock(&vs->writer);
+
+	/* the current version only changes under the writer lock */
+	draft->number = vs->current->number + 1;
+	draft->pins = 1;
+	draft->root = vs->current->root;
+	draft->older = NULL;
+	if (draft->root)
+		++draft->root->refs;
+	return draft;
+}
+
+/* bitset_versioned_set(vs, draft, index, state)
+ |   sets a bit of a draft to the specified state; the path from the
+ |   root to the block is copied where it is still shared with other
+ |   versions, so that they keep their contents;
+ |   returns 1 on success, 0 if memory could not be allocated (the
+ |   draft is left unchanged)
+ | vs:    valid pointer to a [struct bitset_versioned]
+ | draft: version returned by bitset_versioned_begin
+ | index: the offset of the bit
+ | state: a boolean value expressing the bit's new state
+ */
+int bitset_versioned_set(struct bitset_versioned *vs,
+                         struct bitset_version *draft, size_t index,
+                         unsigned int state)
+{
+	size_t block = index / BITSET_VERSIONED_BLOCK;
+	unsigned int height = vs->height;
+	unsigned int level;
+
+	/* a missing node or block means the bit is clear already */
+	void *ptr = draft->root;
+	for (level = 0; ptr && level < height; ++level)
+		ptr = *bitset_versioned_slot(ptr, block, level, height);
+	if (!ptr && !state)
+		return 1;
+
+	/* allocate every copy before the first one is linked in; below a
+	 | shared node everything is reachable from other versions too */
+	void *fresh[BITSET_VERSIONED_LEVELS + 1];
+	int shared = 0;
+	ptr = draft->root;
+	for (level = 0; level <= height; ++level) {
+		fresh[level] = NULL;
+		shared |= ptr && bitset_versioned_refs(ptr) > 1;
+		if (!ptr || shared) {
+			size_t bytes = bitset_versioned_bytes(level, height);
+			fresh[level] = ptr ? malloc(bytes) : calloc(1, bytes);
+			if (!fresh[level]) {
+				while (level--)
+					free(fresh[level]);
+				return 0;
+			}
+		}
+		if (ptr && level < height)
+			ptr = *bitset_versioned_slot(ptr, block, level, height);
+	}
+
+	/* link the copies top-down; a copy takes over one reference to
+	 | each child of the original */
+	void **slot = (void **)&draft->root;
+	for (level = 0; level <= height; ++level) {
+		ptr = *slot;
+		if (fresh[level]) {
+			if (ptr) {
+				memcpy(fresh[level], ptr, bitset_versioned_bytes(level, height));
+				if (level < height) {
+					struct bitset_versioned_node *node = ptr;
+					for (size_t i = 0; i < BITSET_VERSIONED_FANOUT; ++i)
+						if (node->child[i])
+							++bitset_versioned_refs(node->child[i]);
+				}
+				--bitset_versioned_refs(ptr);
+			}
+			bitset_versioned_refs(fresh[level]) = 1;
+			*slot = ptr = fresh[level];
+		}
+		if (level < height)
+			slot = bitset_versioned_slot(ptr, block, level, height);
+	}
+
+	struct bitset_versioned_block *data = ptr;
+	unsigned char *entry = data->data + (index % BITSET_VERSIONED_BLOCK) / 8;
+	*entry ^= (-!!state ^ *entry) & (1 << (index & 0x7));
+	return 1;
+}
+
+/* bitset_versioned_commit(vs, draft)
+ |   makes a draft the current version, visible to all later pins, and
+ |   reclaims old versions that are not pinned;
+ |   returns the number of the new version
+ | vs:    valid pointer to a [struct bitset_versioned]
+ | draft: version returned by bitset_versioned_begin
+ */
+size_t bitset_versioned_commit(struct bitset_versioned *vs,
+                               struct bitset_version *draft)
+{
+	/* once the writer lock is released, the version may be freed */
+	size_t number = draft->number;
+	pthread_mutex_lock(&vs->lock);
+	struct bitset_version *old = vs->current;
+	vs->current = draft;
+	--old->pins;
+	old->older = vs->older;
+	vs->older = old;
+	pthread_mutex_unlock(&vs->lock);
+
+	bitset_versioned_collect(vs);
+	pthread_mutex_unlock(&vs->writer);
+	return number;
+}
+
+/* bitset_versioned_abort(vs, draft)
+ |   discards a draft and the blocks it copied, and reclaims the old
+ |   versions that were unpinned while the writer was active
+ | vs:    valid pointer to a [struct bitset_versioned]
+ | draft: version returned by bitset_versioned_begin
+ */
+void bitset_versioned_abort(struct bitset_versioned *vs,
+                            struct bitset_version *draft)
+{
+	bitset_versioned_drop(vs, draft);
+	bitset_versioned_collect(vs);
+	pthread_mutex_unlock(&vs->writer);
+}
+
+/* bitset_version_get(vs, version, index)
+ |   gets the state of a bit in a pinned version or a draft
+ | vs:      valid pointer to a [struct bitset_versioned]
+ | version: pinned version or draft
+ | index:   the offset of the bit
+ */
+unsigned int bitset_version_get(struct bitset_versioned *vs,
+                                struct bitset_version *version, size_t index)
+{
+	size_t block = index / BITSET_VERSIONED_BLOCK;
+	void *ptr = version->root;
+	for (unsigned int level = 0; ptr && level < vs->height; ++level)
+		ptr = *bitset_versioned_slot(ptr, block, level, vs->height);
+	if (!ptr)
+		return 0;
+
+	struct bitset_versioned_block *data = ptr;
+	return data->data[(index % BITSET_VERSIONED_BLOCK) / 8] >> (index & 0x7) & 1;
+}
+
+static
+size_t bitset_versioned_count(void *ptr, unsigned int level,
+                              unsigned int height)
+{
+	size_t count = 0;
+	if (!ptr)
+		return 0;
+	if (level < height) {
+		struct bitset_versioned_node *node = ptr;
+		for (size_t i = 0; i < BITSET_VERSIONED_FANOUT; ++i)
+			count += bitset_versioned_count(node->child[i], level + 1, height);
+		return count;
+	}
+
+	struct bitset_versioned_block *data = ptr;
+	for (size_t i = 0; i < sizeof(data->data); i += 8)
+		count += bitset_internal_popcount(bitset_internal_load(data->data + i, 8));
+	return count;
+}
+
+/* bitset_version_count(vs, version)
+ |   returns the number of set bits of a pinned version or a draft,
+ |   skipping subtrees that were never written
+ | vs:      valid pointer to a [struct bitset_versioned]
+ | version: pinned version or draft
+ */
+size_t bitset_version_count(struct bitset_versioned *vs,
+                            struct bitset_version *version)
+{
+	return bitset_versioned_count(version->root, 0, vs->height);
+}
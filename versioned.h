@@ -0,0 +1,84 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef BITSET_VERSIONED_H
+#define BITSET_VERSIONED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitset.h"
+
+/* bits per block and children per node of the version trees */
+#define BITSET_VERSIONED_BLOCK  4096
+#define BITSET_VERSIONED_FANOUT 64
+
+/* node of a version tree; children are nodes, or blocks on the lowest
+ | level, and missing children are all zero. Nodes and blocks are
+ | shared between versions and counted by the number of parents */
+struct bitset_versioned_node {
+	size_t refs;
+	void *child[BITSET_VERSIONED_FANOUT];
+};
+
+struct bitset_versioned_block {
+	size_t refs;
+	unsigned char data[BITSET_VERSIONED_BLOCK / 8];
+};
+
+/* immutable view of the bitset once committed; pins counts the readers
+ | plus one while it is the current version */
+struct bitset_version {
+	size_t number;
+	size_t pins;
+	struct bitset_versioned_node *root;
+	struct bitset_version *older;
+};
+
+/* multi-version bitset with one writer at a time; lock guards current,
+ | older and the pins, writer is held from begin to commit and while
+ | versions are reclaimed */
+struct bitset_versioned {
+	size_t size;
+	unsigned int height;
+	struct bitset_version *current;
+	struct bitset_version *older;
+	pthread_mutex_t lock;
+	pthread_mutex_t writer;
+};
+
+struct bitset_versioned *bitset_versioned_new(size_t size);
+void bitset_versioned_free(struct bitset_versioned *vs);
+
+struct bitset_version *bitset_versioned_pin(struct bitset_versioned *vs);
+void bitset_versioned_unpin(struct bitset_versioned *vs,
+                            struct bitset_version *version);
+size_t bitset_versioned_reclaim(struct bitset_versioned *vs);
+
+struct bitset_version *bitset_versioned_begin(struct bitset_versioned *vs);
+int bitset_versioned_set(struct bitset_versioned *vs,
+                         struct bitset_version *draft, size_t index,
+                         unsigned int state);
+size_t bitset_versioned_commit(struct bitset_versioned *vs,
+                               struct bitset_version *draft);
+void bitset_versioned_abort(struct bitset_versioned *vs,
+                            struct bitset_version *draft);
+
+unsigned int bitset_version_get(struct bitset_versioned *vs,
+                                struct bitset_version *version, size_t index);
+size_t bitset_version_count(struct bitset_versioned *vs,
+                            struct bitset_version *version);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BITSET_VERSIONED_H */
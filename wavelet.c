@@ -0,0 +1,420 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset.h"
+#include "rank.h"
+#include "wavelet.h"
+#include "internal.c"
+
+/* one slice of a level during construction; slices start on word
+ | boundaries so that no two threads write the same byte */
+struct bitset_wavelet_job {
+	const uint64_t *src;
+	uint64_t *dst;
+	struct bitset *level;
+	unsigned int shift;
+	size_t begin;
+	size_t end;
+	size_t zeros;
+	size_t zero_at;
+	size_t one_at;
+};
+
+static
+void *bitset_wavelet_count(void *arg)
+{
+	struct bitset_wavelet_job *job = arg;
+	size_t ones = 0;
+	for (size_t i = job->begin; i < job->end; ++i)
+		ones += job->src[i] >> job->shift & 1;
+	job->zeros = job->end - job->begin - ones;
+	return NULL;
+}
+
+static
+void *bitset_wavelet_scatter(void *arg)
+{
+	struct bitset_wavelet_job *job = arg;
+	size_t zero_at = job->zero_at, one_at = job->one_at;
+	unsigned char *data = job->level->data;
+
+	for (size_t i = job->begin; i < job->end; i += 64) {
+		size_t n = job->end - i < 64 ? job->end - i : 64;
+		uint64_t word = 0;
+		for (size_t j = 0; j < n; ++j) {
+			uint64_t v = job->src[i + j];
+			uint64_t bit = v >> job->shift & 1;
+			word |= bit << j;
+			if (bit)
+				job->dst[one_at++] = v;
+			else
+				job->dst[zero_at++] = v;
+		}
+		bitset_internal_store(data + (i >> 3), word, (n + 7) >> 3);
+	}
+	return NULL;
+}
+
+/* runs fn over all jobs, on threads if there is more than one */
+static
+void bitset_wavelet_run(void *(*fn)(void *), struct bitset_wavelet_job *jobs,
+                        unsigned int num, pthread_t *tids)
+{
+	unsigned int started = 1;
+	for (; started < num; ++started)
+		if (pthread_create(tids + started, NULL, fn, jobs + started))
+			break;
+	fn(jobs);
+	/* run what could not be started on this thread */
+	for (unsigned int t = started; t < num; ++t)
+		fn(jobs + t);
+	for (unsigned int t = 1; t < started; ++t)
+		pthread_join(tids[t], NULL);
+}
+
+/* bitset_wavelet_new(values, num, bits, threads)
+ |   builds a wavelet matrix over a sequence of integers; every level is
+ |   a stable partition of the previous one, computed by splitting the
+ |   sequence into slices that are counted and scattered in parallel;
+ |   returns a pointer to the allocated struct
+ | values:  sequence of num integers, each smaller than 2^bits
+ | num:     length of the sequence
+ | bits:    bit width of the values (1 to 64)
+ | threads: number of threads used for construction, 0 or 1 for none
+ */
+struct bitset_wavelet *bitset_wavelet_new(const uint64_t *values, size_t num,
+                                          unsigned int bits,
+                                          unsigned int threads)
+{
+	if (!bits || bits > 64 || !num)
+		return NULL;
+	if (!threads)
+		threads = 1;
+	if (threads > (num + 63) / 64)
+		threads = (num + 63) / 64;
+
+	struct bitset_wavelet *wm = calloc(1, sizeof(struct bitset_wavelet));
+	uint64_t *cur = malloc(num * sizeof(uint64_t));
+	uint64_t *next = malloc(num * sizeof(uint64_t));
+	struct bitset_wavelet_job *jobs = malloc(threads * sizeof(*jobs));
+	pthread_t *tids = malloc(threads * sizeof(pthread_t));
+	if (!wm || !cur || !next || !jobs || !tids)
+		goto fail;
+	wm->size = num;
+	wm->bits = bits;
+	wm->levels = calloc(bits, sizeof(struct bitset *));
+	wm->ranks = calloc(bits, sizeof(struct bitset_rank *));
+	wm->zeros = calloc(bits, sizeof(size_t));
+	if (!wm->levels || !wm->ranks || !wm->zeros)
+		goto fail;
+	memcpy(cur, values, num * sizeof(uint64_t));
+
+	size_t words = bitset_internal_words(num);
+	for (unsigned int t = 0; t < threads; ++t) {
+		jobs[t].begin = (words * t / threads) << 6;
+		jobs[t].end = (words * (t + 1) / threads) << 6;
+		if (jobs[t].end > num)
+			jobs[t].end = num;
+	}
+
+	for (unsigned int l = 0; l < bits; ++l) {
+		struct bitset *level = bitset_alloc(num);
+		if (!level)
+			goto fail;
+		wm->levels[l] = level;
+
+		for (unsigned int t = 0; t < threads; ++t) {
+			jobs[t].src = cur;
+			jobs[t].dst = next;
+			jobs[t].level = level;
+			jobs[t].shift = bits - 1 - l;
+		}
+		bitset_wavelet_run(bitset_wavelet_count, jobs, threads, tids);
+
+		size_t zeros = 0;
+		for (unsigned int t = 0; t < threads; ++t)
+			zeros += jobs[t].zeros;
+		size_t zero_at = 0, one_at = zeros;
+		for (unsigned int t = 0; t < threads; ++t) {
+			jobs[t].zero_at = zero_at;
+			jobs[t].one_at = one_at;
+			zero_at += jobs[t].zeros;
+			one_at += jobs[t].end - jobs[t].begin - jobs[t].zeros;
+		}
+		bitset_wavelet_run(bitset_wavelet_scatter, jobs, threads, tids);
+
+		wm->zeros[l] = zeros;
+		wm->ranks[l] = bitset_rank_new(level);
+		if (!wm->ranks[l])
+			goto fail;
+
+		uint64_t *tmp = cur;
+		cur = next;
+		next = tmp;
+	}
+
+	free(cur);
+	free(next);
+	free(jobs);
+	free(tids);
+	return wm;
+
+fail:
+	free(cur);
+	free(next);
+	free(jobs);
+	free(tids);
+	if (wm)
+		bitset_wavelet_free(wm);
+	return NULL;
+}
+
+/* bitset_wavelet_free(wm)
+ |   frees memory associated with the given wavelet matrix
+ | wm: pointer to a [struct bitset_wavelet]
+ */
+void bitset_wavelet_free(struct bitset_wavelet *wm)
+{
+	for (unsigned int l = 0; l < wm->bits; ++l) {
+		if (wm->ranks && wm->ranks[l])
+			bitset_rank_free(wm->ranks[l]);
+		if (wm->levels && wm->levels[l])
+			bitset_free(wm->levels[l]);
+	}
+	free(wm->levels);
+	free(wm->ranks);
+	free(wm->zeros);
+	free(wm);
+}
+
+/* maps a position on level l to the level below, following bit */
+static inline
+size_t bitset_wavelet_down(struct bitset_wavelet *wm, unsigned int l,
+                           size_t pos, unsigned int bit)
+{
+	if (bit)
+		return wm->zeros[l] + bitset_rank1(wm->ranks[l], pos);
+	return bitset_rank0(wm->ranks[l], pos);
+}
+
+/* bitset_wavelet_access(wm, index)
+ |   returns the value at the specified position of the sequence
+ | wm:    valid pointer to a [struct bitset_wavelet]
+ | index: position in the sequence, smaller than its length
+ */
+uint64_t bitset_wavelet_access(struct bitset_wavelet *wm, size_t index)
+{
+	uint64_t value = 0;
+	for (unsigned int l = 0; l < wm->bits; ++l) {
+		unsigned int bit = !!bitset_get(wm->levels[l], index);
+		value = value << 1 | bit;
+		index = bitset_wavelet_down(wm, l, index, bit);
+	}
+	return value;
+}
+
+/* bitset_wavelet_rank(wm, c, index)
+ |   returns the number of occurrences of c before the specified index
+ | wm:    valid pointer to a [struct bitset_wavelet]
+ | c:     value to count
+ | index: position up to which to count (exclusive), at most the length
+ */
+size_t bitset_wavelet_rank(struct bitset_wavelet *wm, uint64_t c,
+                           size_t index)
+{
+	size_t begin = 0;
+	if (wm->bits < 64 && c >> wm->bits)
+		return 0;
+	for (unsigned int l = 0; l < wm->bits; ++l) {
+		unsigned int bit = c >> (wm->bits - 1 - l) & 1;
+		begin = bitset_wavelet_down(wm, l, begin, bit);
+		index = bitset_wavelet_down(wm, l, index, bit);
+	}
+	return index - begin;
+}
+
+/* bitset_wavelet_select(wm, c, k)
+ |   returns the position of the occurrence of c preceded by exactly k
+ |   occurrences, or SIZE_MAX if c occurs at most k times
+ | wm: valid pointer to a [struct bitset_wavelet]
+ | c:  value to search for
+ | k:  number of occurrences before the searched one
+ */
+size_t bitset_wavelet_select(struct bitset_wavelet *wm, uint64_t c, size_t k)
+{
+	size_t begin = 0, end = wm->size;
+	if (wm->bits < 64 && c >> wm->bits)
+		return SIZE_MAX;
+	for (unsigned int l = 0; l < wm->bits; ++l) {
+		unsigned int bit = c >> (wm->bits - 1 - l) & 1;
+		begin = bitset_wavelet_down(wm, l, begin, bit);
+		end = bitset_wavelet_down(wm, l, end, bit);
+	}
+	if (k >= end - begin)
+		return SIZE_MAX;
+
+	/* walk back up, mapping the position through each level */
+	size_t pos = begin + k;
+	for (unsigned int l = wm->bits; l--; ) {
+		if (c >> (wm->bits - 1 - l) & 1)
+			pos = bitset_select1(wm->ranks[l], pos - wm->zeros[l]);
+		else
+			pos = bitset_select0(wm->ranks[l], pos);
+	}
+	return pos;
+}
+
+/* bitset_wavelet_quantile(wm, begin, end, k)
+ |   returns the k-th smallest value (counting from 0) among the
+ |   positions begin to (end - 1); k must be smaller than (end - begin)
+ | wm:    valid pointer to a [struct bitset_wavelet]
+ | begin: first position of the range (inclusive)
+ | end:   last position of the range (exclusive)
+ | k:     rank of the value within the sorted range
+ */
+uint64_t bitset_wavelet_quantile(struct bitset_wavelet *wm, size_t begin,
+                                 size_t end, size_t k)
+{
+	uint64_t value = 0;
+	for (unsigned int l = 0; l < wm->bits; ++l) {
+		size_t zb = bitset_rank0(wm->ranks[l], begin);
+		size_t ze = bitset_rank0(wm->ranks[l], end);
+		if (k < ze - zb) {
+			value <<= 1;
+			begin = zb;
+			end = ze;
+		} else {
+			k -= ze - zb;
+			value = value << 1 | 1;
+			begin = wm->zeros[l] + (begin - zb);
+			end = wm->zeros[l] + (end - ze);
+		}
+	}
+	return value;
+}
+
+/* node of the best-first search of bitset_wavelet_topk */
+struct bitset_wavelet_node {
+	size_t begin;
+	size_t end;
+	unsigned int level;
+	uint64_t value;
+};
+
+/* wider ranges first; among equal widths the deeper node, so that
+ | ties are resolved depth-first */
+static inline
+int bitset_wavelet_before(const struct bitset_wavelet_node *a,
+                          const struct bitset_wavelet_node *b)
+{
+	size_t wa = a->end - a->begin, wb = b->end - b->begin;
+	return wa > wb || (wa == wb && a->level > b->level);
+}
+
+static
+void bitset_wavelet_push(struct bitset_wavelet_node *heap, size_t *num,
+                         struct bitset_wavelet_node node)
+{
+	size_t i = (*num)++;
+	while (i) {
+		size_t parent = (i - 1) / 2;
+		if (!bitset_wavelet_before(&node, heap + parent))
+			break;
+		heap[i] = heap[parent];
+		i = parent;
+	}
+	heap[i] = node;
+}
+
+static
+struct bitset_wavelet_node bitset_wavelet_pop(struct bitset_wavelet_node *heap,
+                                              size_t *num)
+{
+	struct bitset_wavelet_node top = heap[0];
+	struct bitset_wavelet_node last = heap[--*num];
+	size_t i = 0;
+	for (;;) {
+		size_t child = 2 * i + 1;
+		if (child >= *num)
+			break;
+		if (child + 1 < *num &&
+		    bitset_wavelet_before(heap + child + 1, heap + child))
+			++child;
+		if (!bitset_wavelet_before(heap + child, &last))
+			break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = last;
+	return top;
+}
+
+/* bitset_wavelet_topk(wm, begin, end, k, values, counts)
+ |   finds the k most frequent values among the positions begin to
+ |   (end - 1) by expanding the largest subranges first;
+ |   returns the number of values found, in order of descending count
+ | wm:     valid pointer to a [struct bitset_wavelet]
+ | begin:  first position of the range (inclusive)
+ | end:    last position of the range (exclusive)
+ | k:      maximum number of values
+ | values: pointer to memory for k values
+ | counts: pointer to memory for k counts
+ */
+size_t bitset_wavelet_topk(struct bitset_wavelet *wm, size_t begin,
+                           size_t end, size_t k,
+                           uint64_t *values, size_t *counts)
+{
+	size_t capacity = 64;
+	struct bitset_wavelet_node *heap = malloc(capacity * sizeof(*heap));
+	size_t num = 0, found = 0;
+	if (!heap || begin >= end)
+		goto done;
+
+	struct bitset_wavelet_node root = { begin, end, 0, 0 };
+	bitset_wavelet_push(heap, &num, root);
+	while (num && found < k) {
+		struct bitset_wavelet_node node = bitset_wavelet_pop(heap, &num);
+		if (node.level == wm->bits) {
+			values[found] = node.value;
+			counts[found++] = node.end - node.begin;
+			continue;
+		}
+
+		if (num + 2 > capacity) {
+			struct bitset_wavelet_node *grown =
+				realloc(heap, 2 * capacity * sizeof(*heap));
+			if (!grown)
+				break;
+			heap = grown;
+			capacity *= 2;
+		}
+
+		unsigned int l = node.level;
+		size_t zb = bitset_rank0(wm->ranks[l], node.begin);
+		size_t ze = bitset_rank0(wm->ranks[l], node.end);
+		struct bitset_wavelet_node zero = {
+			zb, ze, l + 1, node.value << 1
+		};
+		struct bitset_wavelet_node one = {
+			wm->zeros[l] + (node.begin - zb), wm->zeros[l] + (node.end - ze),
+			l + 1, node.value << 1 | 1
+		};
+		if (zero.end > zero.begin)
+			bitset_wavelet_push(heap, &num, zero);
+		if (one.end > one.begin)
+			bitset_wavelet_push(heap, &num, one);
+	}
+
+done:
+	free(heap);
+	return found;
+}
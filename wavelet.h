@@ -0,0 +1,50 @@
+/* Copyright (c) 2017 Jonas van den Berg <jonas.vanen@gmail.com>
+ * 
+ * bitset is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef BITSET_WAVELET_H
+#define BITSET_WAVELET_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitset.h"
+#include "rank.h"
+
+/* wavelet matrix over a sequence of integers of a fixed bit width;
+ | level l holds bit (bits - 1 - l) of every value, in the order of
+ | a stable partition by the levels above it */
+struct bitset_wavelet {
+	size_t size;
+	unsigned int bits;
+	struct bitset **levels;
+	struct bitset_rank **ranks;
+	size_t *zeros;
+};
+
+struct bitset_wavelet *bitset_wavelet_new(const uint64_t *values, size_t num,
+                                          unsigned int bits,
+                                          unsigned int threads);
+void bitset_wavelet_free(struct bitset_wavelet *wm);
+
+uint64_t bitset_wavelet_access(struct bitset_wavelet *wm, size_t index);
+size_t bitset_wavelet_rank(struct bitset_wavelet *wm, uint64_t c,
+                           size_t index);
+size_t bitset_wavelet_select(struct bitset_wavelet *wm, uint64_t c, size_t k);
+uint64_t bitset_wavelet_quantile(struct bitset_wavelet *wm, size_t begin,
+                                 size_t end, size_t k);
+size_t bitset_wavelet_topk(struct bitset_wavelet *wm, size_t begin,
+                           size_t end, size_t k,
+                           uint64_t *values, size_t *counts);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BITSET_WAVELET_H */